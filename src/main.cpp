@@ -1,127 +1,840 @@
 // C++, SDL2 + ImGui viewer for raw image bitstreams
 // Made by Kae <TG@kaens, GitHub@Kaens>
+// RAWVIEWER_NO_GUI leaves out the window and main(), for tests that include the decoding core
 
+#ifndef RAWVIEWER_NO_GUI
 #include <SDL.h>
 #include <SDL_video.h>
+#endif
 #include <cstdio>
 #include <cstdlib>
 #include <cstdint>
 #include <cstring>
+#include <cerrno>
+#include <cmath>
 #include <vector>
 #include <string>
 #include <fstream>
+#include <sstream>
+#include <span>
+#include <string_view>
 #include <iostream>
 #include <optional>
 #include <algorithm>
+#include <numeric>
 #include <cassert>
 #include <filesystem>
+#include <bit>
+#include <array>
+#include <utility>
+#include <tuple>
+#include <limits>
+#include <memory>
+#include <list>
+#include <deque>
+#include <unordered_map>
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#ifdef _WIN32
+#define NOMINMAX
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif
 
+#ifndef RAWVIEWER_NO_GUI
 #include "imgui.h"
 #include "imgui_impl_sdl2.h"
 #include "imgui_impl_opengl3.h"
 #include <GL/gl.h>
 #include "nfd_sdl2.h"
 #include "stb_image_write.h"
+#endif
 
 using namespace std;
 
 // ------------------------------ Simple bitreader utilities ------------------------------
-static inline uint32_t read_bits_msb(const uint8_t* data, size_t total_bits, size_t bitpos, int nbits) {
-    // read nbits MSB-first from data starting at bitpos; not optimised
-    uint32_t val = 0;
-    for (int i = 0; i < nbits; ++i) {
-        size_t p = bitpos + i;
-        uint8_t bit = 0;
-        if (p < total_bits) bit = (data[p >> 3] >> (7 - (p & 7))) & 1u;
-        val = (val << 1) | bit;
-    }
-    return val;
-}
-
-static inline uint32_t read_bits_lsb(
-  const uint8_t* data,
-  const size_t total_bits,
-  const size_t bitpos,
-  const int nbits
-) {
-    size_t val = 0;
-    for (auto i = 0; i < nbits; ++i) {
-        size_t p = bitpos + i;
-        uint8_t bit = 0;
-        if (p < total_bits) {
-            size_t bidx = p >> 3;
-            uint8_t bit_in_byte = p & 7;
-            bit = (data[bidx] >> bit_in_byte) & 1u;
-        }
-        val |= static_cast<size_t>(bit << i);
-    }
-    return val;
-}
-
-static inline uint64_t adjust_endianness_pixel(const size_t pixel_val, const int bpp, const bool little_endian) {
-    if (!little_endian || bpp <= 8) return pixel_val & ((bpp >= 64) ? ~0ull : ((1ull << bpp) - 1ull));
-    const uint8_t nbytes = (bpp + 7) / 8;
-    uint8_t bytes[8] = {};
-    for (auto i = 0; i < nbytes; ++i) {
-        const auto shift = (nbytes - 1 - i) * 8;
-        bytes[i] = (pixel_val >> shift) & 0xFFu;
-    }
-    // reverse the bytes for little-endian interpretation
-    uint64_t out = 0;
-    for (auto i = 0; i < nbytes; ++i) {
-        out = (out << 8) | bytes[nbytes - 1 - i];
-    }
-    return out & ((1ull << bpp) - 1ull);
+static inline uint64_t load_le64(const uint8_t* p) {
+    uint64_t v;
+    memcpy(&v, p, sizeof v);
+    if constexpr (endian::native == endian::big) v = byteswap(v);
+    return v;
+}
+
+static inline uint64_t load_be64(const uint8_t* p) {
+    uint64_t v;
+    memcpy(&v, p, sizeof v);
+    if constexpr (endian::native == endian::little) v = byteswap(v);
+    return v;
+}
+
+static inline void store_le64(uint8_t* p, uint64_t v) {
+    if constexpr (endian::native == endian::big) v = byteswap(v);
+    memcpy(p, &v, sizeof v);
+}
+
+static inline void store_be64(uint8_t* p, uint64_t v) {
+    if constexpr (endian::native == endian::little) v = byteswap(v);
+    memcpy(p, &v, sizeof v);
+}
+
+// Word-at-a-time bit stream: every read is one unaligned 64-bit load plus two shifts for fields
+// of up to 57 bits (64 minus the worst-case bit offset); wider fields take two loads.
+// There are no bounds checks here: the caller guarantees 8 readable bytes at (pos >> 3),
+// render_viewport checks this once per row and pads the file tail (see BitRowSource).
+constexpr int bitstream_max_bits = 57;
+constexpr int max_bpp = 64;
+
+template <bool Msb>
+struct BitStream {
+    const uint8_t* data;
+    size_t pos; // bit position
+
+    uint64_t peek(const int nbits) const { // nbits <= bitstream_max_bits
+        const uint8_t* p = data + (pos >> 3);
+        const unsigned sh = pos & 7;
+        if constexpr (Msb) return (load_be64(p) << sh) >> (64 - nbits);
+        else return (load_le64(p) >> sh) & (~0ull >> (64 - nbits));
+    }
+    uint64_t read(const int nbits) { // nbits <= max_bpp
+        if (nbits > bitstream_max_bits) [[unlikely]] {
+            const uint64_t first = peek(32);
+            pos += 32;
+            const uint64_t second = peek(nbits - 32);
+            pos += nbits - 32;
+            if constexpr (Msb) return (first << (nbits - 32)) | second;
+            else return first | (second << 32);
+        }
+        const uint64_t v = peek(nbits);
+        pos += nbits;
+        return v;
+    }
+};
+
+// Hands out a pointer that is safe to run a BitStream over for one row. Rows that end well
+// inside the buffer read it in place; the last row of the file is copied into a zero-padded
+// scratch buffer so the 64-bit loads never run past the end (missing bits read as 0).
+struct BitRowSource {
+    const uint8_t* data;
+    size_t size; // bytes
+    vector<uint8_t> tail;
+
+    // returns the stream base for bits [bitpos, bitpos + nbits), rebasing bitpos if needed
+    const uint8_t* row(size_t& bitpos, const size_t nbits) {
+        const size_t first = bitpos >> 3;
+        const size_t last = (bitpos + nbits + 7) >> 3; // one past the last byte the row touches
+        if (last + 8 <= size) return data;
+        tail.assign(last - first + 8, 0);
+        if (first < size) memcpy(tail.data(), data + first, min(size, last) - first);
+        bitpos &= 7;
+        return tail.data();
+    }
+};
+
+static inline uint64_t bpp_mask(const int bpp) { return ~0ull >> (64 - bpp); } // bpp in 1..64
+
+// How the bytes of a pixel value are rearranged after reading it from the stream
+// (a partial top byte counts as a byte). Indices match the "Byte order" combo.
+enum ByteOrder : int {
+    byte_order_none,    // as read: big-endian for MSB-first streams, little-endian for LSB-first
+    byte_order_reverse, // all bytes of the pixel reversed (the old "LE" checkbox)
+    byte_order_swap16,  // bytes swapped within each 16-bit word
+    byte_order_swap32,  // bytes reversed within each 32-bit word
+    byte_order_pdp,     // 16-bit halves of each 32-bit word swapped (PDP-11 middle-endian)
+};
+static const char* const byte_order_labels[] = {"As read", "Reverse all", "Swap 16-bit", "Swap 32-bit", "PDP (middle)"};
+
+// Value byte that ends up at byte i (0 = least significant) of an nbytes-byte pixel.
+// The word swaps leave a byte alone when its partner lies past the top of the pixel.
+static constexpr int byte_order_source(const int order, const int i, const int nbytes) {
+    int j = i;
+    switch (order) {
+        case byte_order_reverse: return nbytes - 1 - i;
+        case byte_order_swap16: j = i ^ 1; break;
+        case byte_order_swap32: j = i ^ 3; break;
+        case byte_order_pdp: j = i ^ 2; break;
+        default: break;
+    }
+    return j < nbytes ? j : i;
+}
+
+// Apply a ByteOrder to one pixel. Renderers only call this where no faster path exists
+// (table builds, odd pixel widths); whole rows are reordered in bulk, see decode_kernels.inc.
+static inline uint64_t adjust_endianness_pixel(const uint64_t pixel_val, const int bpp, const int order) {
+    if (order == byte_order_none || bpp <= 8) return pixel_val & bpp_mask(bpp);
+    const int nbytes = (bpp + 7) / 8;
+    if (order == byte_order_reverse) return (byteswap(pixel_val) >> (64 - nbytes * 8)) & bpp_mask(bpp);
+    uint64_t v = 0;
+    for (int i = 0; i < nbytes; ++i) v |= ((pixel_val >> (byte_order_source(order, i, nbytes) * 8)) & 0xFF) << (i * 8);
+    return v & bpp_mask(bpp);
 }
 
 // ------------------------------ Preset description ------------------------------
-struct Field { char name; int bits; }; // 'r','g','b','a','y' (y=gray)
+// 'r','g','b','a','y' (y=gray), 'x' (padding); signed fields are shown offset by half their range,
+// lsb_first ones have their bits stored in reverse order
+struct Field {
+    char name;
+    int bits;
+    bool is_signed{false};
+    bool lsb_first{false};
+    bool operator==(const Field&) const = default;
+};
 struct Preset {
     string label;
     vector<int> bpps;
     vector<Field> fields;
     bool lsb_order {false};
+    int builtin {-1}; // index into builtin_layouts, or -1 if the preset has no specialised kernel
+};
+
+// Built-in layouts live in a constexpr table so the renderer can instantiate a kernel per layout
+struct Layout { const char* label; int bpp; Field fields[4]; };
+static constexpr Layout builtin_layouts[] = { //not all of these are common
+    {"1-bit: Monochrome (MSB)", 1, {{'y',1}}},
+    {"2-bit: Grayscale", 2, {{'y',2}}},
+    {"4-bit: Grayscale", 4, {{'y',4}}},
+    {"4-bit: 2R-1G-1B", 4, {{'r',2}, {'g',1}, {'b',1}}},
+    {"8-bit: Grayscale", 8, {{'y',8}}},
+    {"8-bit: R3-G3-B2", 8, {{'r',3}, {'g',3}, {'b',2}}},
+    {"8-bit: B3-G3-R2", 8, {{'b',3}, {'g',3}, {'r',2}}},
+    {"8-bit: R2-G3-B3", 8, {{'r',2}, {'g',3}, {'b',3}}},
+    {"8-bit: A2-R2-G2-B2", 8, {{'a',2}, {'r',2}, {'g',2}, {'b',2}}},
+    {"8-bit: A1-R2-G3-B2", 8, {{'a',1}, {'r',2}, {'g',3}, {'b',2}}},
+    {"16-bit: R5-G6-B5", 16, {{'r',5}, {'g',6}, {'b',5}}},
+    {"16-bit: A1-R5-G5-B5", 16, {{'a',1}, {'r',5}, {'g',5}, {'b',5}}},
+    {"16-bit: R4-G4-B4-A4", 16, {{'r',4}, {'g',4}, {'b',4}, {'a',4}}},
+    {"16-bit: R3-G4-B3", 16, {{'r',3}, {'g',4}, {'b',3}}},
+    {"16-bit: B3-G4-R3", 16, {{'b',3}, {'g',4}, {'r',3}}},
+    {"16-bit: A1-R3-G3-B3", 16, {{'a',1}, {'r',3}, {'g',3}, {'b',3}}},
+    {"24-bit: R-G-B", 24, {{'r',8}, {'g',8}, {'b',8}}},
+    {"24-bit: B-G-R", 24, {{'b',8}, {'g',8}, {'r',8}}},
+    {"32-bit: R-G-B-A", 32, {{'r',8}, {'g',8}, {'b',8}, {'a',8}}},
+    {"32-bit: A-R-G-B", 32, {{'a',8}, {'r',8}, {'g',8}, {'b',8}}},
+    {"32-bit: A-B-G-R", 32, {{'a',8}, {'b',8}, {'g',8}, {'r',8}}},
+    {"32-bit: B-G-R-A", 32, {{'b',8}, {'g',8}, {'r',8}, {'a',8}}},
+    {"48-bit: R16-G16-B16", 48, {{'r',16}, {'g',16}, {'b',16}}},
+    {"64-bit: R16-G16-B16-A16", 64, {{'r',16}, {'g',16}, {'b',16}, {'a',16}}},
+    {"64-bit: Grayscale", 64, {{'y',64}}},
 };
 
-static vector<Preset> build_presets() { //not all of these are common
+static constexpr int layout_field_count(const Layout& l) {
+    int n = 0;
+    while (n < 4 && l.fields[n].bits > 0) ++n;
+    return n;
+}
+
+static vector<Preset> build_presets() {
     vector<Preset> p;
-    p.push_back({"1-bit: Monochrome (MSB)", {1}, {{'y',1}}});
-    p.push_back({"4-bit: Grayscale", {4}, {{'y',4}}});
-    p.push_back({"4-bit: 2R-1G-1B", {4}, {{'r',2}, {'g',1}, {'b',1}}});
-    p.push_back({"8-bit: Grayscale", {8}, {{'y',8}}});
-    p.push_back({"8-bit: R3-G3-B2", {8}, {{'r',3}, {'g',3}, {'b',2}}});
-    p.push_back({"8-bit: B3-G3-R2", {8}, {{'b',3}, {'g',3}, {'r',2}}});
-    p.push_back({"8-bit: R2-G3-B3", {8}, {{'r',2}, {'g',3}, {'b',3}}});
-    p.push_back({"8-bit: A2-R2-G2-B2", {8}, {{'a',2}, {'r',2}, {'g',2}, {'b',2}}});
-    p.push_back({"8-bit: A1-R2-G3-B2", {8}, {{'a',1}, {'r',2}, {'g',3}, {'b',2}}});
-    p.push_back({"16-bit: R5-G6-B5", {16}, {{'r',5}, {'g',6}, {'b',5}}});
-    p.push_back({"16-bit: A1-R5-G5-B5", {16}, {{'a',1}, {'r',5}, {'g',5}, {'b',5}}});
-    p.push_back({"16-bit: R4-G4-B4-A4", {16}, {{'r',4}, {'g',4}, {'b',4}, {'a',4}}});
-    p.push_back({"16-bit: R3-G4-B3", {16}, {{'r',3}, {'g',4}, {'b',3}}});
-    p.push_back({"16-bit: B3-G4-R3", {16}, {{'b',3}, {'g',4}, {'r',3}}});
-    p.push_back({"16-bit: A1-R3-G3-B3", {16}, {{'a',1}, {'r',3}, {'g',3}, {'b',3}}});
-    p.push_back({"24-bit: R-G-B", {24}, {{'r',8}, {'g',8}, {'b',8}}});
-    p.push_back({"24-bit: B-G-R", {24}, {{'b',8}, {'g',8}, {'r',8}}});
-    p.push_back({"32-bit: R-G-B-A", {32}, {{'r',8}, {'g',8}, {'b',8}, {'a',8}}});
-    p.push_back({"32-bit: A-R-G-B", {32}, {{'a',8}, {'r',8}, {'g',8}, {'b',8}}});
-    p.push_back({"32-bit: A-B-G-R", {32}, {{'a',8}, {'b',8}, {'g',8}, {'r',8}}});
-    p.push_back({"32-bit: B-G-R-A", {32}, {{'b',8}, {'g',8}, {'r',8}, {'a',8}}});
+    for (int i = 0; i < static_cast<int>(size(builtin_layouts)); ++i) {
+        const auto& l = builtin_layouts[i];
+        p.push_back({l.label, {l.bpp}, {l.fields, l.fields + layout_field_count(l)}, false, i});
+    }
     return p;
 }
 
+// ------------------------------ Preset file ------------------------------
+// One preset per line, "label = field field ...", fields MSB to LSB written as name and bits plus
+// optional suffixes: s = signed, l = stored LSB first. "#" starts a comment. E.g.
+//   RGB565 after a 4-bit tag = x4 r5 g6 b5
+//   Signed height + alpha = y12s a4
+// bpp is the sum of the field bits (1..64). Presets that match a built-in layout use its kernel.
+static const char* const preset_file_name = "rawviewer_presets.txt";
+
+// Appends the valid presets in path to presets; returns one message per rejected line
+static vector<string> load_preset_file(const string& path, vector<Preset>& presets) {
+    vector<string> errors;
+    ifstream in(path);
+    if (!in) return errors; // the file is optional
+    string line;
+    for (int line_no = 1; getline(in, line); ++line_no) {
+        if (const auto hash = line.find('#'); hash != string::npos) line.erase(hash);
+        if (line.find_first_not_of(" \t\r") == string::npos) continue;
+        auto fail = [&](const string& why) { errors.push_back(path + ":" + to_string(line_no) + ": " + why); };
+        const auto eq = line.find('=');
+        string label = line.substr(0, eq);
+        label.erase(label.find_last_not_of(" \t") + 1);
+        label.erase(0, label.find_first_not_of(" \t"));
+        if (eq == string::npos || label.empty()) {
+            fail("expected \"label = fields\"");
+            continue;
+        }
+        Preset preset{label, {}, {}};
+        istringstream tokens(line.substr(eq + 1));
+        int total = 0;
+        string token, bad;
+        while (tokens >> token && bad.empty()) {
+            size_t digits = 1;
+            while (digits < token.size() && isdigit(static_cast<unsigned char>(token[digits]))) ++digits;
+            Field f{token[0], digits > 1 ? atoi(token.substr(1, digits - 1).c_str()) : 0};
+            for (const char flag : token.substr(digits)) {
+                if (flag == 's') f.is_signed = true;
+                else if (flag == 'l') f.lsb_first = true;
+                else f.bits = 0;
+            }
+            if (string_view("rgbayx").find(f.name) == string_view::npos || f.bits < 1 || f.bits > 64 || (f.is_signed && f.bits < 2))
+                bad = token;
+            total += f.bits;
+            preset.fields.push_back(f);
+        }
+        if (!bad.empty()) fail("bad field \"" + bad + "\"");
+        else if (total < 1 || total > 64) fail("fields add up to " + to_string(total) + " bits, need 1..64");
+        if (!bad.empty() || total < 1 || total > 64) continue;
+        preset.bpps = {total};
+        for (int i = 0; i < static_cast<int>(size(builtin_layouts)); ++i) {
+            const auto& l = builtin_layouts[i];
+            if (ranges::equal(preset.fields, span(l.fields, layout_field_count(l)))) preset.builtin = i;
+        }
+        presets.push_back(move(preset));
+    }
+    return errors;
+}
+
+// ------------------------------ File bytes ------------------------------
+// Files are read with pread into 1 MiB blocks, kept until the memory budget is reached and then
+// dropped least recently used first. The kernel is told to drop its own copy of each block it
+// reads, so paging through a file far larger than RAM holds on to about `budget` bytes of it.
+// A loader thread per file does the reading: blocks the view asks for first, then those the
+// readahead expects it to ask for next, then the rest of the file from there on, for as long as
+// that fits in the budget without pushing anything out.
+class BlockCache {
+public:
+    static constexpr size_t block_size = size_t{1} << 20;
+    static inline atomic<size_t> budget = size_t{256} << 20; // shared by all open files
+
+    using Range = pair<size_t, size_t>; // file bytes [first, second)
+    struct Stats {
+        size_t resident; // bytes held
+        size_t target;   // bytes the loader fills up to: the whole file, or the budget
+        size_t pending;  // blocks the view is waiting for
+        uint64_t hits, misses; // block lookups by the view
+        uint64_t prefetched, prefetch_hits; // blocks read ahead, and how many of them the view then used
+    };
+
+    BlockCache() = default;
+    BlockCache(const BlockCache&) = delete;
+    BlockCache& operator=(const BlockCache&) = delete;
+    ~BlockCache();
+
+    static shared_ptr<BlockCache> open(const string& path); // nullptr unless it can be read at any offset
+
+    size_t size() const { return size_; }
+    Stats stats() const;
+    unsigned generation() const { return generation_; } // changes whenever a block comes in
+
+    // Both copy [ofs, ofs + n), which must lie within the file. read waits for missing blocks;
+    // read_loaded never waits: it zero-fills them, appends their bytes to `missing` and has the
+    // loader fetch them ahead of anything asked for before (a view reading several ranges passes
+    // the same `missing`, empty for the first, so the later ranges don't replace the earlier;
+    // `more` says a read into a fresh `missing` is still part of the same view).
+    void read(size_t ofs, size_t n, uint8_t* dst);
+    void read_loaded(size_t ofs, size_t n, uint8_t* dst, vector<Range>& missing, bool more = false);
+    // Replaces the blocks to read ahead with those of [ofs, ofs + n), queued nearest the view
+    // first: from ofs up, or from the end down when scrolling backwards
+    void prefetch(size_t ofs, size_t n, bool backward);
+
+private:
+    struct Block {
+        vector<uint8_t> bytes;
+        list<size_t>::iterator lru;
+        bool prefetched{}; // read ahead and not looked at since
+    };
+    // with the lock held
+    Block* find(size_t index);
+    const uint8_t* view_block(size_t index); // find, counting hits and misses
+    const uint8_t* insert(size_t index, vector<uint8_t> bytes, bool prefetched = false);
+    vector<uint8_t> spare();
+    optional<size_t> next_unloaded();
+    // without it
+    void read_block(size_t index, vector<uint8_t>& bytes) const;
+    void load();
+
+#ifdef _WIN32
+    HANDLE file_{INVALID_HANDLE_VALUE};
+#else
+    int fd_{-1};
+#endif
+    size_t size_{}, nblocks_{};
+    unordered_map<size_t, Block> blocks_;
+    list<size_t> lru_; // block indices, most recently used first
+    uint64_t hits_{}, misses_{}, prefetched_{}, prefetch_hits_{};
+
+    mutable mutex mutex_;
+    condition_variable wake_;
+    deque<size_t> wanted_; // by the view, most urgent first
+    deque<size_t> ahead_;  // by the readahead, nearest first
+    Range advised_{};      // blocks the kernel was last told to read ahead
+    bool fetching_{};      // the loader is reading a wanted block
+    size_t stream_{};      // where the loader continues when nothing is wanted
+    atomic<unsigned> generation_{};
+    bool stop_{};
+    thread loader_;
+};
+
+BlockCache::~BlockCache() {
+    if (loader_.joinable()) {
+        {
+            lock_guard lock(mutex_);
+            stop_ = true;
+        }
+        wake_.notify_all();
+        loader_.join();
+    }
+#ifdef _WIN32
+    if (file_ != INVALID_HANDLE_VALUE) CloseHandle(file_);
+#else
+    if (fd_ >= 0) ::close(fd_);
+#endif
+}
+
+shared_ptr<BlockCache> BlockCache::open(const string& path) {
+    auto cache = make_shared<BlockCache>();
+#ifdef _WIN32
+    cache->file_ = CreateFileW(filesystem::path(path).c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE, nullptr,
+                               OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_RANDOM_ACCESS, nullptr);
+    LARGE_INTEGER sz{};
+    if (cache->file_ == INVALID_HANDLE_VALUE || GetFileType(cache->file_) != FILE_TYPE_DISK || !GetFileSizeEx(cache->file_, &sz))
+        return nullptr;
+    cache->size_ = static_cast<size_t>(sz.QuadPart);
+#else
+    cache->fd_ = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    struct stat st{};
+    if (cache->fd_ < 0 || fstat(cache->fd_, &st) != 0 || !(S_ISREG(st.st_mode) || S_ISBLK(st.st_mode))) return nullptr;
+    const off_t end = lseek(cache->fd_, 0, SEEK_END); // st_size is 0 for block devices
+    if (end < 0) return nullptr;
+    cache->size_ = static_cast<size_t>(end);
+    posix_fadvise(cache->fd_, 0, 0, POSIX_FADV_RANDOM); // blocks are read whole, readahead only adds to them
+#endif
+    cache->nblocks_ = (cache->size_ + block_size - 1) / block_size;
+    cache->loader_ = thread(&BlockCache::load, cache.get());
+    return cache;
+}
+
+BlockCache::Stats BlockCache::stats() const {
+    lock_guard lock(mutex_);
+    return {blocks_.size() * block_size, min(nblocks_, max<size_t>(1, budget / block_size)) * block_size,
+            wanted_.size() + fetching_, hits_, misses_, prefetched_, prefetch_hits_};
+}
+
+BlockCache::Block* BlockCache::find(const size_t index) {
+    const auto it = blocks_.find(index);
+    if (it == blocks_.end()) return nullptr;
+    lru_.splice(lru_.begin(), lru_, it->second.lru);
+    return &it->second;
+}
+
+const uint8_t* BlockCache::view_block(const size_t index) {
+    Block* b = find(index);
+    if (!b) {
+        ++misses_;
+        return nullptr;
+    }
+    ++hits_;
+    if (b->prefetched) ++prefetch_hits_;
+    b->prefetched = false;
+    return b->bytes.data();
+}
+
+// Over budget, least recently used blocks make room (a block read meanwhile is dropped)
+const uint8_t* BlockCache::insert(const size_t index, vector<uint8_t> bytes, const bool prefetched) {
+    if (const Block* b = find(index)) return b->bytes.data();
+    prefetched_ += prefetched;
+    while (!lru_.empty() && (blocks_.size() + 1) * block_size > budget) {
+        blocks_.erase(lru_.back());
+        lru_.pop_back();
+    }
+    lru_.push_front(index);
+    ++generation_;
+    return blocks_.emplace(index, Block{std::move(bytes), lru_.begin(), prefetched}).first->second.bytes.data();
+}
+
+// The buffer of the block the next insert would push out, so reads don't allocate once full
+vector<uint8_t> BlockCache::spare() {
+    vector<uint8_t> bytes;
+    if (!lru_.empty() && (blocks_.size() + 1) * block_size > budget) {
+        const auto victim = blocks_.find(lru_.back());
+        bytes = std::move(victim->second.bytes);
+        blocks_.erase(victim);
+        lru_.pop_back();
+    }
+    return bytes;
+}
+
+optional<size_t> BlockCache::next_unloaded() {
+    if (blocks_.size() >= nblocks_ || (blocks_.size() + 1) * block_size > budget) return nullopt;
+    for (size_t i = 0; i < nblocks_; ++i, stream_ = stream_ + 1 < nblocks_ ? stream_ + 1 : 0)
+        if (!blocks_.contains(stream_)) return stream_;
+    return nullopt;
+}
+
+void BlockCache::read_block(const size_t index, vector<uint8_t>& bytes) const {
+    const size_t ofs = index * block_size, n = min(block_size, size_ - ofs);
+    bytes.resize(n);
+    size_t got = 0;
+#ifdef _WIN32
+    while (got < n) {
+        OVERLAPPED at{};
+        at.Offset = static_cast<DWORD>(ofs + got);
+        at.OffsetHigh = static_cast<DWORD>((ofs + got) >> 32);
+        DWORD r = 0;
+        if (!ReadFile(file_, bytes.data() + got, static_cast<DWORD>(n - got), &r, &at) || !r) break;
+        got += r;
+    }
+#else
+    while (got < n) {
+        const ssize_t r = pread(fd_, bytes.data() + got, n - got, static_cast<off_t>(ofs + got));
+        if (r < 0 && errno == EINTR) continue;
+        if (r <= 0) break;
+        got += static_cast<size_t>(r);
+    }
+    posix_fadvise(fd_, static_cast<off_t>(ofs), static_cast<off_t>(n), POSIX_FADV_DONTNEED);
+#endif
+    fill(bytes.begin() + got, bytes.end(), 0); // read errors (or a file that shrank) read as zeros
+}
+
+void BlockCache::load() {
+    unique_lock lock(mutex_);
+    while (!stop_) {
+        optional<size_t> next;
+        while (!next && !wanted_.empty()) {
+            if (!blocks_.contains(wanted_.front())) next = wanted_.front();
+            wanted_.pop_front();
+        }
+        fetching_ = next.has_value();
+        while (!next && !ahead_.empty()) {
+            if (!blocks_.contains(ahead_.front())) next = ahead_.front();
+            ahead_.pop_front();
+        }
+        const bool ahead = next && !fetching_;
+        if (!next) next = next_unloaded();
+        if (!next) { // all in, or the budget is full: wait for the view (or a larger budget)
+            wake_.wait_for(lock, chrono::milliseconds(100));
+            continue;
+        }
+        vector<uint8_t> bytes = fetching_ || ahead ? spare() : vector<uint8_t>{};
+        lock.unlock();
+        read_block(*next, bytes);
+        lock.lock();
+        insert(*next, std::move(bytes), ahead);
+        fetching_ = false;
+    }
+}
+
+void BlockCache::read(size_t ofs, size_t n, uint8_t* dst) {
+    unique_lock lock(mutex_);
+    while (n) {
+        const size_t index = ofs / block_size, in = ofs % block_size, k = min(n, block_size - in);
+        const uint8_t* p = view_block(index);
+        if (!p) {
+            vector<uint8_t> bytes = spare();
+            lock.unlock();
+            read_block(index, bytes);
+            lock.lock();
+            p = insert(index, std::move(bytes));
+        }
+        memcpy(dst, p + in, k);
+        dst += k;
+        ofs += k;
+        n -= k;
+    }
+}
+
+void BlockCache::read_loaded(size_t ofs, size_t n, uint8_t* dst, vector<Range>& missing, const bool more) {
+    {
+        lock_guard lock(mutex_);
+        bool first_missing = missing.empty() && !more;
+        while (n) {
+            const size_t index = ofs / block_size, in = ofs % block_size, k = min(n, block_size - in);
+            if (const uint8_t* p = view_block(index)) {
+                memcpy(dst, p + in, k);
+            } else {
+                memset(dst, 0, k);
+                if (!missing.empty() && missing.back().second == ofs) missing.back().second += k;
+                else missing.emplace_back(ofs, ofs + k);
+                if (first_missing) wanted_.clear(); // the view moved on, earlier requests can wait
+                first_missing = false;
+                if (ranges::find(wanted_, index) == wanted_.end()) wanted_.push_back(index);
+                stream_ = index + 1 < nblocks_ ? index + 1 : 0;
+            }
+            dst += k;
+            ofs += k;
+            n -= k;
+        }
+    }
+    wake_.notify_one();
+}
+
+void BlockCache::prefetch(const size_t ofs, size_t n, const bool backward) {
+    n = ofs < size_ ? min(n, size_ - ofs) : 0;
+    {
+        lock_guard lock(mutex_);
+        ahead_.clear();
+        const Range blocks{ofs / block_size, n ? (ofs + n - 1) / block_size + 1 : ofs / block_size};
+        for (size_t k = blocks.first; k < blocks.second; ++k) {
+            const size_t i = backward ? blocks.second - 1 - (k - blocks.first) : k;
+            if (blocks_.contains(i)) continue;
+            ahead_.push_back(i);
+#ifndef _WIN32
+            // lets the kernel start on all of them while the loader goes one block at a time
+            if (i < advised_.first || i >= advised_.second)
+                posix_fadvise(fd_, static_cast<off_t>(i * block_size), static_cast<off_t>(block_size), POSIX_FADV_WILLNEED);
+#endif
+        }
+        advised_ = blocks;
+    }
+    wake_.notify_one();
+}
+
+// The bytes being viewed: a file read through its block cache, or bytes in memory (pipes and
+// other inputs that can't be read by offset, decode windows). Copies share the bytes.
+class ByteSource {
+public:
+    ByteSource() = default;
+    explicit ByteSource(vector<uint8_t> bytes) {
+        auto owned = make_shared<const vector<uint8_t>>(std::move(bytes));
+        ptr_ = owned->data();
+        size_ = owned->size();
+        owned_ = std::move(owned);
+    }
+
+    static optional<ByteSource> open(const string& path);
+
+    size_t size() const { return size_; }
+    bool empty() const { return size_ == 0; }
+    // The bytes in memory, nullptr for a cached file (use read)
+    const uint8_t* data() const { return ptr_; }
+    const uint8_t* begin() const { return ptr_; }
+    const uint8_t* end() const { return ptr_ + size_; }
+    const uint8_t& operator[](const size_t i) const { return ptr_[i]; }
+    BlockCache* cache() const { return cache_.get(); }
+
+    // Copy [ofs, ofs + n), which must lie within the bytes; see BlockCache
+    void read(const size_t ofs, const size_t n, uint8_t* dst) const {
+        if (cache_) cache_->read(ofs, n, dst);
+        else if (n) memcpy(dst, ptr_ + ofs, n);
+    }
+    void read_loaded(const size_t ofs, const size_t n, uint8_t* dst, vector<BlockCache::Range>& missing,
+                     const bool more = false) const {
+        if (cache_) cache_->read_loaded(ofs, n, dst, missing, more);
+        else if (n) memcpy(dst, ptr_ + ofs, n);
+    }
+
+private:
+    shared_ptr<const vector<uint8_t>> owned_;
+    shared_ptr<BlockCache> cache_;
+    const uint8_t* ptr_{};
+    size_t size_{};
+};
+
+optional<ByteSource> ByteSource::open(const string& path) {
+    ByteSource src;
+    if ((src.cache_ = BlockCache::open(path))) {
+        src.size_ = src.cache_->size();
+        return src;
+    }
+    // pipes and the like: read them whole
+    ifstream in(path, ios::binary);
+    if (!in) return nullopt;
+    return ByteSource(vector<uint8_t>(istreambuf_iterator<char>(in), istreambuf_iterator<char>()));
+}
+
 // ------------------------------ Renderer ------------------------------
-struct ViewerState {
-    vector<uint8_t> data;
-    string filename;
-    int stofs{};
+// Planar layouts: bpp is then the number of bitplanes and bit p of a pixel's value comes from plane p
+enum PlaneLayout : int {
+    planes_off,   // chunky: pixels are consecutive bpp-bit fields
+    planes_rows,  // each row holds one line per plane in turn (Amiga ILBM)
+    planes_words, // every 16 pixels hold one 16-bit word per plane in turn (Atari ST)
+    planes_whole, // each plane is a whole image, plane_stride bytes apart (EGA, raw Amiga bitplanes)
+};
+static const char* const plane_layout_labels[] = {"Off (chunky)", "Interleaved rows", "Interleaved words", "Whole planes"};
+constexpr int max_planes = 8;
+
+// Tile layouts: the stream is a sequence of tile_w x tile_h tiles filling the view left to right
+enum TileFormat : int {
+    tiles_off,    // plain rows
+    tiles_linear, // chunky pixels, tile rows back to back (Genesis 4bpp, GBA with LSB bit order)
+    tiles_nes,    // 2 planes, all rows of plane 0 then all rows of plane 1
+    tiles_gb,     // 2 planes, the two plane bytes of each row interleaved
+    tiles_snes,   // 2/4/8 planes, plane pairs stored like GB tiles one after another (SNES, PC Engine)
+};
+static const char* const tile_format_labels[] = {"Off (rows)", "Linear (Genesis/GBA)", "NES 2bpp planar", "GB 2bpp interleaved", "SNES/PCE planar"};
+
+// Where the planes of a planar tile live: plane p of tile row r is tile byte ofs[p] + r * row_step
+struct TilePlanes {
+    int nplanes;
+    int row_step;
+    int ofs[max_planes];
+};
+
+static TilePlanes tile_planes(const int format, const int bpp, const int tile_h) {
+    TilePlanes tp{format == tiles_snes ? clamp(bpp, 1, max_planes) : 2, format == tiles_nes ? 1 : 2, {}};
+    for (int p = 0; p < tp.nplanes; ++p)
+        tp.ofs[p] = format == tiles_nes ? p * tile_h : format == tiles_gb ? p : p / 2 * 2 * tile_h + p % 2;
+    return tp;
+}
+
+// Swizzled textures: pixels are stored in a console-specific order instead of row by row
+enum Swizzle : int {
+    swizzle_off,
+    swizzle_morton, // Z-order over power-of-two squares
+    swizzle_psp,    // 16-byte x 8-row blocks, row-major
+    swizzle_ps2,    // GS PSMCT32 addressing: 64x32 pages of 8x8 blocks made of 8x2 columns (in pixels)
+    swizzle_gc,     // GameCube/Wii blocks: 8x8 at 4 bpp, 8x4 at 8 bpp, 4x4 above, row-major; 32 bpp
+                    // blocks hold 16 AR pairs, then 16 GB pairs
+};
+static const char* const swizzle_labels[] = {"Off (linear)", "Morton / Z-order", "PSP", "PS2 GS (PSMCT32)", "GameCube / Wii"};
+
+// Block-compressed textures: 4x4 texel blocks, width_px texels wide
+enum BlockFormat : int { blocks_off, blocks_bc1, blocks_bc2, blocks_bc3, blocks_bc4, blocks_bc5 };
+static const char* const block_format_labels[] = {"None", "BC1 (DXT1)", "BC2 (DXT3)", "BC3 (DXT5)", "BC4 (ATI1)", "BC5 (ATI2)"};
+static constexpr int block_bytes(const int format) { return format == blocks_bc1 || format == blocks_bc4 ? 8 : 16; }
+
+// YUV frames: packed 4:2:2 (one chroma pair per two pixels) or planar 4:2:0 (one per 2x2 pixels)
+enum YuvFormat : int { yuv_off, yuv_yuyv, yuv_uyvy, yuv_nv12, yuv_i420 };
+static const char* const yuv_format_labels[] = {"None", "YUYV (4:2:2)", "UYVY (4:2:2)", "NV12 (4:2:0)", "I420 (4:2:0)"};
+
+// Float pixels (GPU readbacks, HDR targets): little-endian IEEE half or single components
+enum FloatFormat : int { float_off, float_r16f, float_rg16f, float_rgba16f, float_r32f, float_rg32f, float_rgba32f };
+static const char* const float_format_labels[] = {"None", "R16F", "RG16F", "RGBA16F", "R32F", "RG32F", "RGBA32F"};
+static constexpr int float_channels(const int format) { return format == float_r16f || format == float_r32f ? 1 : format == float_rg16f || format == float_rg32f ? 2 : 4; }
+static constexpr int float_pixel_bytes(const int format) { return float_channels(format) * (format <= float_rgba16f ? 2 : 4); }
+
+// Camera sensor dumps: RAW8/RAW16 or MIPI CSI-2 packed RAW10/RAW12 samples, usually a Bayer mosaic
+enum RawFormat : int { raw_off, raw_8, raw_10, raw_12, raw_16 };
+static const char* const raw_format_labels[] = {"None", "RAW8", "MIPI RAW10", "MIPI RAW12", "RAW16 (LE)"};
+static constexpr int raw_bits(const int format) { return format == raw_8 ? 8 : format == raw_10 ? 10 : format == raw_12 ? 12 : 16; }
+// bytes of a row of width samples; MIPI rows are whole packing groups (4 samples RAW10, 2 RAW12)
+static constexpr size_t raw_row_bytes(const int format, const size_t width) {
+    return format == raw_10 ? (width + 3) / 4 * 5 : format == raw_12 ? (width + 1) / 2 * 3 : width * raw_bits(format) / 8;
+}
+enum BayerPattern : int { bayer_off, bayer_rggb, bayer_bggr, bayer_grbg, bayer_gbrg };
+static const char* const bayer_labels[] = {"None (gray)", "RGGB", "BGGR", "GRBG", "GBRG"};
+
+// Deep grayscale (heightmaps, sample data, 12/16-bit scientific rasters): one 9..16-bit value per
+// 16-bit container, shown through a window of values mapped onto 0..255
+enum DeepGray : int { deep_off, deep_unsigned, deep_signed };
+static const char* const deep_gray_labels[] = {"None", "Unsigned", "Signed"};
+enum WindowMode : int { window_manual, window_minmax, window_percentile };
+static const char* const window_mode_labels[] = {"Manual", "Auto min/max", "Auto 1-99%"};
+
+// Byte transforms undo light obfuscation or filtering before decoding; see window_view
+enum TransformKind : int { transform_xor, transform_delta, transform_nibble_swap, transform_bit_reverse };
+static const char* const transform_labels[] = {"XOR key", "Delta (per row)", "Swap nibbles", "Reverse bits"};
+constexpr int max_key_bytes = 32;
+
+struct Transform {
+    int kind{transform_xor};
+    int distance{1}; // delta: each byte is relative to the one this many bytes before it
+    array<char, max_key_bytes * 2 + 1> key_hex{}; // xor: the key as hex digits, repeating from file offset 0
+    bool operator==(const Transform&) const = default;
+};
+
+// Hex digit pairs -> bytes; anything else is skipped
+static vector<uint8_t> parse_hex_key(const char* hex) {
+    vector<uint8_t> key;
+    int digits = 0, byte = 0;
+    for (; *hex; ++hex) {
+        const char c = static_cast<char>(tolower(static_cast<unsigned char>(*hex)));
+        const int v = c >= '0' && c <= '9' ? c - '0' : c >= 'a' && c <= 'f' ? c - 'a' + 10 : -1;
+        if (v < 0) continue;
+        byte = byte << 4 | v;
+        if (++digits % 2 == 0) key.push_back(static_cast<uint8_t>(byte & 0xFF));
+    }
+    return key;
+}
+
+// How to interpret the data, kept apart from the data itself so it can be copied cheaply
+struct ViewSettings {
+    int64_t stofs{}; // bytes; offsets are 64-bit throughout, files can be many GB
     int width_px{256}; // "int" as per InputInt in ImGui
     int bpp{8};
     int bit_align{};
-    int preset_idx{3}; // 8-bit grayscale, corresponds with bpp
+    int row_stride_bits{}; // distance between row starts; 0 = rows are packed (width_px * bpp)
+    int planar{planes_off}; // PlaneLayout
+    int64_t plane_stride{}; // bytes between whole planes; 0 = split the rest of the file evenly
+    int tile_format{tiles_off}; // TileFormat
+    int tile_w{8}; // planar tile formats are always 8 wide
+    int tile_h{8};
+    int swizzle{swizzle_off}; // Swizzle, for plain rows only
+    int block_format{blocks_off}; // BlockFormat
+    int yuv_format{yuv_off}; // YuvFormat
+    bool yuv_bt709{false}; // BT.601 otherwise
+    bool yuv_full_range{false}; // limited (16..235 luma) otherwise
+    int64_t chroma_ofs{}; // bytes from the start offset to the UV (NV12) or U (I420) plane
+    int64_t chroma2_ofs{}; // bytes from the start offset to the V plane (I420)
+    int raw_format{raw_off}; // RawFormat
+    int bayer{bayer_rggb}; // BayerPattern of the top left 2x2 pixels
+    int black_level{};
+    int white_level{}; // 0 = the format's maximum
+    int deep_gray{deep_off}; // DeepGray
+    int deep_bits{16};
+    int window_mode{window_minmax}; // WindowMode
+    int window_level{32768}; // manual window centre, in sample values (recentred on 0 for signed data)
+    int window_width{65536};
+    int float_format{float_off}; // FloatFormat
+    bool float_auto_range{true}; // map the visible min..max to 0..255, otherwise 0..1 after exposure
+    float float_exposure{}; // stops
+    bool indexed{false}; // pixels (up to 8 bpp) are palette indices
+    int64_t palette_ofs{};
+    int palette_format{}; // index into palette_formats
+    int palette_entries{256};
+    int preset_idx{4}; // 8-bit grayscale, corresponds with bpp
     bool bit_order_msb{true};
-    bool byte_order_le{false};
+    int byte_order{byte_order_none}; // ByteOrder
+};
+
+struct ViewerState : ViewSettings {
+    ByteSource data;
+    vector<Transform> transforms; // applied to the bytes in order; window copies hold them applied
+    string filename;
+    unsigned data_version{}; // new on every load and window copy with other bytes, so caches can tell data apart
+    int64_t data_base{}; // file offset of data[0]; window copies start further into the file
+    static inline unsigned versions{}; // the last data_version handed out
 };
 
+// Bytes one plane of one row takes up (planar layouts only)
+static inline size_t plane_row_bytes(const ViewerState& s) {
+    const size_t w = max(1, s.width_px);
+    return s.planar == planes_words ? (w + 15) / 16 * 2 : (w + 7) / 8;
+}
+
+// Tile formats: tile size (width only matters for linear tiles) and bits per tile
+static inline int tile_width(const ViewerState& s) { return s.tile_format == tiles_linear ? max(1, s.tile_w) : 8; }
+static inline size_t tile_bits(const ViewerState& s) {
+    const int h = max(1, s.tile_h);
+    if (s.tile_format == tiles_linear) return static_cast<size_t>(tile_width(s)) * h * s.bpp;
+    const int nplanes = tile_planes(s.tile_format, s.bpp, h).nplanes;
+    return static_cast<size_t>(s.tile_format == tiles_snes ? (nplanes + 1) / 2 * 2 : nplanes) * h * 8; // whole plane pairs
+}
+
+static inline size_t row_stride_bits(const ViewerState& s) {
+    if (s.tile_format != tiles_off) { // average per pixel row
+        const int per_row = max(1, max(1, s.width_px) / tile_width(s));
+        return tile_bits(s) * per_row / max(1, s.tile_h);
+    }
+    if (s.block_format != blocks_off) return static_cast<size_t>(max(1, s.width_px) + 3) / 4 * block_bytes(s.block_format) * 2;
+    if (s.row_stride_bits > 0) return s.row_stride_bits;
+    if (s.raw_format != raw_off) return raw_row_bytes(s.raw_format, max(1, s.width_px)) * 8;
+    if (s.deep_gray != deep_off) return static_cast<size_t>(max(1, s.width_px)) * 16;
+    if (s.float_format != float_off) return static_cast<size_t>(max(1, s.width_px)) * float_pixel_bytes(s.float_format) * 8;
+    if (s.yuv_format == yuv_yuyv || s.yuv_format == yuv_uyvy) return static_cast<size_t>(max(1, s.width_px) + 1) / 2 * 32;
+    if (s.yuv_format != yuv_off) return static_cast<size_t>(max(1, s.width_px)) * 8; // luma plane
+    switch (s.planar) {
+        case planes_rows:
+        case planes_words: return plane_row_bytes(s) * s.bpp * 8;
+        case planes_whole: return plane_row_bytes(s) * 8;
+        default: return static_cast<size_t>(max(1, s.width_px)) * s.bpp;
+    }
+}
+
 static inline uint8_t scale_to_8(const uint64_t raw, const uint8_t bits) {
     if (!bits) return 0;
     if (bits >= 8) {
@@ -134,74 +847,1162 @@ static inline uint8_t scale_to_8(const uint64_t raw, const uint8_t bits) {
     return static_cast<uint8_t>((raw * 255u + (maxv / 2)) / maxv);
 }
 
-// Render a viewport (width x rows) into an RGBA buffer (row-major)
-static void render_viewport(const ViewerState& s, const Preset& preset, const int rows,
-                            vector<uint8_t>& out_pixels, uint32_t& out_rows_rendered) {
+// ------------------------------ Compiled presets ------------------------------
+// A preset is compiled (for a given bpp and byte order) into at most one op per output channel:
+// take the field at `shift`, mask it, expand it to 8 bits with a multiply/round/shift, and OR it
+// into the RGBA word at `dst`. Everything that doesn't depend on the pixel, i.e. 'y' fanning out
+// to r/g/b, later fields overriding earlier ones, truncated fields, the 255 defaults and the
+// zeroing done by unknown field names, is resolved here, so running the program never branches.
+struct DecodeOp {
+    uint8_t shift;  // source bit position of the field's low bit
+    uint8_t dst;    // bit position of the channel in the RGBA word
+    uint8_t rshift;
+    uint8_t reverse; // LSB-first field: mirror its (up to 8) kept bits, which number `reverse`
+    uint32_t mask;  // 0 for unused ops, which then contribute nothing
+    uint32_t mul;
+    uint32_t bias;
+};
+
+// (v * mul + bias) >> rshift == scale_to_8(v, bits) for every v of 1..7 bits
+struct Expansion { uint32_t mul, bias; uint8_t rshift; };
+static constexpr auto expansions = [] {
+    array<Expansion, 8> e{};
+    for (uint32_t bits = 1; bits < 8; ++bits) {
+        const uint32_t maxv = (1u << bits) - 1;
+        for (uint8_t rs = 0; rs <= 16; ++rs) {
+            const uint32_t mul = ((255u << rs) + maxv / 2) / maxv, bias = (1u << rs) >> 1;
+            bool exact = true;
+            for (uint32_t v = 0; v <= maxv; ++v) exact &= ((v * mul + bias) >> rs) == (v * 255u + maxv / 2) / maxv;
+            if (exact) { e[bits] = {mul, bias, rs}; break; }
+        }
+    }
+    return e;
+}();
+
+static constexpr auto bit_reverse8 = [] {
+    array<uint8_t, 256> t{};
+    for (int v = 0; v < 256; ++v)
+        for (int b = 0; b < 8; ++b) t[v] |= ((v >> b) & 1) << (7 - b);
+    return t;
+}();
+
+struct DecodeProgram {
+    int bpp{};
+    int byte_order{};
+    uint32_t base{};  // channels that don't come from a field
+    uint64_t flip{};  // sign bits of signed fields, turning two's complement into offset binary
+    DecodeOp ops[4]{};
+
+    uint32_t run(uint64_t pixel_val) const {
+        pixel_val = adjust_endianness_pixel(pixel_val, bpp, byte_order) ^ flip;
+        uint32_t px = base;
+        for (const auto& op : ops) {
+            uint32_t v = static_cast<uint32_t>(pixel_val >> op.shift) & op.mask;
+            if (op.reverse) v = bit_reverse8[v] >> (8 - op.reverse);
+            px |= ((v * op.mul + op.bias) >> op.rshift) << op.dst;
+        }
+        return px;
+    }
+};
+
+// RGBA word bit position of channel ch (0..3) such that the word stores as R, G, B, A bytes
+static constexpr uint8_t channel_pos(const int ch) { return endian::native == endian::little ? ch * 8 : (3 - ch) * 8; }
+
+static DecodeProgram compile_preset(const Preset& preset, const int bpp, const int byte_order) {
+    DecodeProgram prog;
+    prog.bpp = bpp;
+    prog.byte_order = byte_order;
+
+    // final source of each channel; an op with mask 0 is the constant `value`
+    struct Source { DecodeOp op; uint8_t value; };
+    Source ch[4] = {{{}, 255}, {{}, 255}, {{}, 255}, {{}, 255}};
+
+    // fields are MSB->LSB in preset.fields
+    int cur_shift = bpp;
+    for (const auto& f : preset.fields) {
+        const int use = min(f.bits, cur_shift);
+        Source src{{}, 0};
+        if (cur_shift > 0 && use > 0) {
+            const int lo = cur_shift - use;
+            // the field's top bits, which for an LSB-first field are the stored low ones
+            const int keep = min(use, 8);
+            const Expansion e = keep < 8 ? expansions[keep] : Expansion{1, 0, 0};
+            src.op = {static_cast<uint8_t>(f.lsb_first ? lo : lo + use - keep), 0, e.rshift,
+                      static_cast<uint8_t>(f.lsb_first ? keep : 0), (1u << keep) - 1, e.mul, e.bias};
+            if (f.is_signed && use == f.bits) prog.flip |= 1ull << (f.lsb_first ? lo : lo + use - 1);
+        }
+        cur_shift -= use;
+        switch (f.name) {
+            case 'x': break;
+            case 'r': ch[0] = src; break;
+            case 'g': ch[1] = src; break;
+            case 'b': ch[2] = src; break;
+            case 'a': ch[3] = src; break;
+            case 'y': ch[0] = ch[1] = ch[2] = src; break;
+            default: ch[0] = ch[1] = ch[2] = {{}, 0};
+        }
+    }
+
+    int n = 0;
+    for (int c = 0; c < 4; ++c) {
+        if (ch[c].op.mask) {
+            prog.ops[n] = ch[c].op;
+            prog.ops[n++].dst = channel_pos(c);
+        } else {
+            prog.base |= static_cast<uint32_t>(ch[c].value) << channel_pos(c);
+        }
+    }
+    return prog;
+}
+
+// When every channel of a byte-aligned pixel is either a constant or one whole source byte
+// (24/32-bit RGB(A) in any order, 16-bit channels reduced to their high byte...), decoding is a
+// pure byte shuffle. Fills gather[] with the source byte of each output channel, -1 for constants.
+// The byte order is folded in, so every ByteOrder costs the same here.
+static bool byte_gather_pattern(const DecodeProgram& prog, const bool msb, int8_t (&gather)[4]) {
+    if (prog.bpp % 8 || prog.bpp <= 8 || prog.flip) return false;
+    const int nbytes = prog.bpp / 8;
+    ranges::fill(gather, -1);
+    for (const auto& op : prog.ops) {
+        if (!op.mask) continue;
+        if (op.mask != 0xFF || op.mul != 1 || op.bias || op.rshift || op.reverse || op.shift % 8) return false;
+        const int ch = endian::native == endian::little ? op.dst / 8 : 3 - op.dst / 8;
+        // as read, MSB-first streams hold the value big-endian and LSB-first little-endian
+        const int src = byte_order_source(prog.byte_order, op.shift / 8, nbytes);
+        gather[ch] = static_cast<int8_t>(msb ? nbytes - 1 - src : src);
+    }
+    return true;
+}
+
+// Everything a row kernel may need besides the row itself; kernels take what they use
+struct KernelArgs {
+    const uint32_t* lut;  // RGBA (memory order) per raw pixel value, for the table-driven kernels
+    uint8_t* scratch;     // row-sized scratch buffer (row bytes + 16)
+    int bpp;
+    const DecodeProgram* prog;
+    bool byte_gather;     // gather[] is valid, see byte_gather_pattern
+    int8_t gather[4];
+};
+using RowKernel = void (*)(const uint8_t* data, size_t bitpos, int count, uint8_t* dst, const KernelArgs& k);
+// planes[p] points at the row's first byte of plane p, lut maps plane indices to RGBA
+using PlanarKernel = void (*)(const uint8_t* const* planes, int nplanes, int count, uint8_t* dst, const uint32_t* lut);
+// decodes a whole 8 x h planar tile into dst (8 RGBA pixels per row, rows back to back)
+using TileKernel = void (*)(const uint8_t* tile, const TilePlanes& tp, int h, uint8_t* dst, const uint32_t* lut);
+// copies view row pixels x < width from src[row_ofs + col_ofs[x]] (RGBA, src_count pixels; 0 past it)
+using SwizzleKernel = void (*)(const uint8_t* src, size_t src_count, size_t row_ofs, const uint32_t* col_ofs, int width, uint8_t* dst);
+// YUV -> RGB in fixed point: R = Y' + V'*rv, G = Y' + U'*gu + V'*gv, B = Y' + U'*bu, where
+// Y' = (Y - y_off) * 2 * y_mul and U', V' = (C - 128) * 4 * coefficient; multipliers are Q15
+// (so they stay below 1 as pmulhrsw needs) and results Q6.
+struct YuvCoeffs { int16_t y_off, y_mul, rv, gu, gv, bu; };
+
+static YuvCoeffs yuv_coeffs(const bool bt709, const bool full_range) {
+    const double kr = bt709 ? 0.2126 : 0.299, kb = bt709 ? 0.0722 : 0.114, kg = 1 - kr - kb;
+    const double ys = full_range ? 1.0 : 255.0 / 219.0, cs = full_range ? 1.0 : 255.0 / 224.0;
+    auto q15 = [](const double v) { return static_cast<int16_t>(lround(v * 32768.0)); };
+    return {static_cast<int16_t>(full_range ? 0 : 16), q15(ys / 2),
+            q15(2 * (1 - kr) * cs / 4), q15(-2 * (1 - kb) * kb / kg * cs / 4),
+            q15(-2 * (1 - kr) * kr / kg * cs / 4), q15(2 * (1 - kb) * cs / 4)};
+}
+
+// Sensor samples v map to (min(v - black, range) * mul + 0x8000) >> 16, i.e. black..white to 0..255
+struct RawLevels { uint16_t black, range; uint32_t mul; };
+
+// black < white, both 0..65535
+static RawLevels levels_between(const int black, const int white) {
+    const auto range = static_cast<uint32_t>(white - black);
+    return {static_cast<uint16_t>(black), static_cast<uint16_t>(range), (255u * 65536 + range / 2) / range};
+}
+
+static RawLevels raw_levels(const ViewerState& s) {
+    const int max_level = (1 << raw_bits(s.raw_format)) - 1;
+    const int white = s.white_level > 0 ? min(s.white_level, max_level) : max_level;
+    return levels_between(clamp(s.black_level, 0, white - 1), white);
+}
+
+// count sensor samples -> count levelled bytes
+using RawKernel = void (*)(const uint8_t* src, int count, uint8_t* dst, const RawLevels& l);
+// one row of levelled Bayer samples -> RGBA, see demosaic_row
+using DemosaicKernel = void (*)(const uint8_t* up, const uint8_t* cur, const uint8_t* down, int count, bool in_red_row, bool g_first, uint8_t* dst);
+// count 16-bit sample containers -> order-preserving 16-bit values, see unpack_gray16
+using Gray16Kernel = void (*)(const uint8_t* src, int count, int bits, uint16_t* dst);
+// count gray bytes -> RGBA
+using GrayKernel = void (*)(const uint8_t* src, int count, uint8_t* dst);
+// transforms n bytes starting at file position file_pos, see apply_transform
+using TransformKernel = void (*)(const Transform& t, uint8_t* data, size_t n, size_t file_pos, size_t row_bytes);
+// count float pixels -> RGBA, colour channels through (v + offset) * scale (see decode_row_float)
+using FloatKernel = void (*)(const uint8_t* src, int count, float offset, float scale, uint8_t* dst);
+// widens lo/hi by the finite colour components among count components
+using FloatRangeKernel = void (*)(const uint8_t* src, size_t count, int format, float& lo, float& hi);
+// one row of YUV pixels, see decode_row_yuv for what y, u and v point at
+using YuvKernel = void (*)(const uint8_t* y, const uint8_t* u, const uint8_t* v, int count, uint8_t* dst, const YuvCoeffs& c);
+// decodes a row of 4x4 blocks into 4 texel rows of blocks * 4 RGBA texels each, pitch bytes apart
+using BlockKernel = void (*)(const uint8_t* src, int blocks, uint8_t* dst, size_t pitch);
+// maps count index frame values (32-bit, unaligned) through a palette_table
+using PaletteKernel = void (*)(const uint8_t* indices, size_t count, uint8_t* dst, const uint32_t* palette);
+
+// ------------------------------ Full-pixel lookup tables ------------------------------
+// For bpp <= 16 every raw pixel value maps to one fixed RGBA output, so decode them all once
+// (byte order included) and make the per-pixel work a single table load. At 16 bpp the table
+// is 256 KiB. It is rebuilt only when the preset fields, bpp or byte order change.
+constexpr int lut_max_bpp = 16;
+
+struct PixelLut {
+    vector<Field> fields;
+    int bpp{};
+    int byte_order{};
+    vector<uint32_t> rgba; // RGBA (memory order), indexed by the raw value as read from the stream
+};
+
+static const uint32_t* pixel_lut(const Preset& preset, const DecodeProgram& prog) {
+    static PixelLut cache;
+    const int bpp = prog.bpp;
+    if (cache.rgba.empty() || cache.fields != preset.fields || cache.bpp != bpp || cache.byte_order != prog.byte_order) {
+        cache.fields = preset.fields;
+        cache.bpp = bpp;
+        cache.byte_order = prog.byte_order;
+        // keep at least 16 entries so the 1/2/4 bpp SIMD kernels can load a full pshufb table
+        cache.rgba.assign(max<size_t>(16, size_t{1} << bpp), 0);
+        for (uint64_t v = 0; v < (1ull << bpp); ++v) cache.rgba[v] = prog.run(v);
+    }
+    return cache.rgba.data();
+}
+
+// ------------------------------ Indexed colour ------------------------------
+// In indexed mode the renderers decode palette indices instead of colours: the table-driven
+// kernels (all of them handle bpp <= 8) are simply given index_lut() in place of the preset's
+// table. render_viewport keeps that index frame and maps it through the palette, so palette
+// changes (and frames where nothing changed) skip the bit decode entirely.
+constexpr int palette_max_bpp = 8;
+
+// Palette entries are decoded like pixels: one field list per format, read MSB-first
+struct PaletteFormat { const char* label; int bpp; Field fields[4]; int byte_order; };
+static constexpr PaletteFormat palette_formats[] = {
+    {"RGB888", 24, {{'r',8}, {'g',8}, {'b',8}}, byte_order_none},
+    {"BGR888", 24, {{'b',8}, {'g',8}, {'r',8}}, byte_order_none},
+    {"RGBA8888", 32, {{'r',8}, {'g',8}, {'b',8}, {'a',8}}, byte_order_none},
+    {"RGB565 LE", 16, {{'r',5}, {'g',6}, {'b',5}}, byte_order_reverse},
+    {"BGR565 LE", 16, {{'b',5}, {'g',6}, {'r',5}}, byte_order_reverse},
+    {"RGB555 LE", 16, {{'x',1}, {'r',5}, {'g',5}, {'b',5}}, byte_order_reverse},
+    {"BGR555 LE (SNES/GBA)", 16, {{'x',1}, {'b',5}, {'g',5}, {'r',5}}, byte_order_reverse},
+};
+static const char* const palette_format_labels[] = {
+    palette_formats[0].label, palette_formats[1].label, palette_formats[2].label, palette_formats[3].label,
+    palette_formats[4].label, palette_formats[5].label, palette_formats[6].label,
+};
+static_assert(size(palette_format_labels) == size(palette_formats));
+
+// Index frames hold index + 1 per pixel so that 0 still means "past the end of the data"
+static const uint32_t* index_lut() {
+    static const auto lut = [] {
+        array<uint32_t, 1 << palette_max_bpp> l{};
+        for (uint32_t i = 0; i < l.size(); ++i) l[i] = i + 1;
+        return l;
+    }();
+    return lut.data();
+}
+
+// Table the table-driven kernels map raw pixel values through this frame
+static const uint32_t* frame_lut(const ViewerState& s, const Preset& preset, const DecodeProgram& prog) {
+    return s.indexed && prog.bpp <= palette_max_bpp ? index_lut() : pixel_lut(preset, prog);
+}
+
+// RGBA per index frame value: [0] = transparent, [i + 1] = palette entry i. Entries that are past
+// palette_entries or the end of the file stay transparent. Rebuilt only when the palette changes,
+// or when blocks it was missing have come in: entries still loading are drawn in placeholder
+// grays, and their bytes are added to `missing` (which must hold the view's missing bytes, so the
+// loader keeps those wanted too).
+static const uint32_t* palette_table(const ViewerState& s, vector<BlockCache::Range>& missing) {
+    static struct {
+        tuple<unsigned, const uint8_t*, size_t, int64_t, int, int> key;
+        array<uint32_t, (1 << palette_max_bpp) + 1> rgba{};
+        vector<BlockCache::Range> missing;
+        unsigned generation{};
+    } cache;
+    const auto key = make_tuple(s.data_version, s.data.data(), s.data.size(), s.palette_ofs, s.palette_format, s.palette_entries);
+    const unsigned generation = s.data.cache() ? s.data.cache()->generation() : 0;
+    if (cache.key == key && (cache.missing.empty() || cache.generation == generation)) {
+        missing.insert(missing.end(), cache.missing.begin(), cache.missing.end());
+        return cache.rgba.data();
+    }
+    cache.key = key;
+    cache.generation = generation;
+    cache.rgba.fill(0);
+    const auto& f = palette_formats[clamp(s.palette_format, 0, static_cast<int>(size(palette_formats)) - 1)];
+    int nfields = 0;
+    while (nfields < 4 && f.fields[nfields].bits > 0) ++nfields;
+    const Preset fields{f.label, {f.bpp}, {f.fields, f.fields + nfields}};
+    const DecodeProgram prog = compile_preset(fields, f.bpp, f.byte_order);
+    const size_t entry_bytes = f.bpp / 8, first = static_cast<size_t>(max<int64_t>(s.palette_ofs, 0));
+    const size_t in_file = first < s.data.size() ? (s.data.size() - first) / entry_bytes : 0;
+    const int entries = static_cast<int>(min<size_t>(clamp(s.palette_entries, 0, 1 << palette_max_bpp), in_file));
+    uint8_t bytes[(1 << palette_max_bpp) * 8];
+    // read into ranges of its own: a shared vector would merge them into the view's last range
+    vector<BlockCache::Range> loading;
+    s.data.read_loaded(first, entries * entry_bytes, bytes, loading, !missing.empty());
+    cache.missing = loading;
+    missing.insert(missing.end(), loading.begin(), loading.end());
+    for (int i = 0; i < entries; ++i) {
+        const size_t ofs = first + i * entry_bytes;
+        bool loading = false;
+        for (const auto& [a, b] : cache.missing) loading |= ofs < b && a < ofs + entry_bytes;
+        if (loading) {
+            const uint8_t v = i % 2 ? 0x50 : 0x38, px[4] = {v, v, v, 255};
+            memcpy(&cache.rgba[i + 1], px, 4);
+            continue;
+        }
+        uint64_t v = 0;
+        for (size_t b = 0; b < entry_bytes; ++b) v = (v << 8) | bytes[i * entry_bytes + b];
+        cache.rgba[i + 1] = prog.run(v);
+    }
+    return cache.rgba.data();
+}
+
+// ------------------------------ Decode kernel variants ------------------------------
+// decode_kernels.inc is compiled once per ISA tier and the best tier the CPU supports is picked
+// at startup. RAWVIEWER_ISA=<name> in the environment or --isa=<name> on the command line forces one.
+// The kernels are optimised for speed even when the rest is built for size (-Os and no inlining
+// with MinGW), so their small helpers still inline and their loops stay tight.
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC push_options
+#pragma GCC optimize("O2", "inline-functions")
+#endif
+namespace isa_scalar {
+#define RAWVIEWER_ISA 0
+#include "decode_kernels.inc"
+#undef RAWVIEWER_ISA
+}
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC pop_options
+#endif
+
+#if defined(__GNUC__) && !defined(__clang__) && (defined(__x86_64__) || defined(__i386__))
+#define RAWVIEWER_MULTI_ISA 1
+#pragma GCC push_options
+#pragma GCC target("sse4.1")
+#pragma GCC optimize("O2", "inline-functions")
+namespace isa_sse41 {
+#define RAWVIEWER_ISA 1
+#include "decode_kernels.inc"
+#undef RAWVIEWER_ISA
+}
+#pragma GCC pop_options
+
+#pragma GCC push_options
+#pragma GCC target("avx2,bmi,bmi2,f16c")
+#pragma GCC optimize("O2", "inline-functions")
+namespace isa_avx2 {
+#define RAWVIEWER_ISA 2
+#include "decode_kernels.inc"
+#undef RAWVIEWER_ISA
+}
+#pragma GCC pop_options
+
+#pragma GCC push_options
+#pragma GCC target("avx512f,avx512bw,avx512vl,avx2,bmi,bmi2,f16c")
+#pragma GCC optimize("O2", "inline-functions")
+namespace isa_avx512 {
+#define RAWVIEWER_ISA 3
+#include "decode_kernels.inc"
+#undef RAWVIEWER_ISA
+}
+#pragma GCC pop_options
+#endif
+
+struct DecodeIsa {
+    const char* name;
+    bool (*supported)();
+    RowKernel (*select)(const ViewerState&, const Preset&, const KernelArgs&);
+    PlanarKernel (*planar)(bool msb);
+    TileKernel (*tile)(bool msb);
+    PaletteKernel palette;
+    SwizzleKernel swizzle;
+    BlockKernel (*block)(int format);
+    YuvKernel (*yuv)(int format);
+    FloatKernel (*float_row)(int format);
+    FloatRangeKernel float_range;
+    RawKernel (*raw)(int format);
+    DemosaicKernel demosaic;
+    GrayKernel gray;
+    Gray16Kernel (*gray16)(bool big_endian, bool is_signed);
+    TransformKernel transform;
+};
+
+static const DecodeIsa decode_isas[] = { // ordered worst to best
+    {"scalar", [] { return true; }, isa_scalar::select_row_kernel, isa_scalar::select_planar_kernel, isa_scalar::select_tile_kernel, isa_scalar::apply_palette, isa_scalar::deswizzle_row, isa_scalar::select_block_kernel, isa_scalar::select_yuv_kernel, isa_scalar::select_float_kernel, isa_scalar::float_range, isa_scalar::select_raw_kernel, isa_scalar::demosaic_row, isa_scalar::expand_gray, isa_scalar::select_gray16_kernel, isa_scalar::apply_transform},
+#ifdef RAWVIEWER_MULTI_ISA
+    {"sse4.1", [] { return __builtin_cpu_supports("sse4.1") != 0; }, isa_sse41::select_row_kernel, isa_sse41::select_planar_kernel, isa_sse41::select_tile_kernel, isa_sse41::apply_palette, isa_sse41::deswizzle_row, isa_sse41::select_block_kernel, isa_sse41::select_yuv_kernel, isa_sse41::select_float_kernel, isa_sse41::float_range, isa_sse41::select_raw_kernel, isa_sse41::demosaic_row, isa_sse41::expand_gray, isa_sse41::select_gray16_kernel, isa_sse41::apply_transform},
+    {"avx2", [] {
+        return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("bmi") && __builtin_cpu_supports("bmi2")
+            && __builtin_cpu_supports("f16c");
+    }, isa_avx2::select_row_kernel, isa_avx2::select_planar_kernel, isa_avx2::select_tile_kernel, isa_avx2::apply_palette, isa_avx2::deswizzle_row, isa_avx2::select_block_kernel, isa_avx2::select_yuv_kernel, isa_avx2::select_float_kernel, isa_avx2::float_range, isa_avx2::select_raw_kernel, isa_avx2::demosaic_row, isa_avx2::expand_gray, isa_avx2::select_gray16_kernel, isa_avx2::apply_transform},
+    {"avx512bw", [] {
+        return __builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512bw")
+            && __builtin_cpu_supports("avx512vl") && __builtin_cpu_supports("bmi") && __builtin_cpu_supports("bmi2")
+            && __builtin_cpu_supports("f16c");
+    }, isa_avx512::select_row_kernel, isa_avx512::select_planar_kernel, isa_avx512::select_tile_kernel, isa_avx512::apply_palette, isa_avx512::deswizzle_row, isa_avx512::select_block_kernel, isa_avx512::select_yuv_kernel, isa_avx512::select_float_kernel, isa_avx512::float_range, isa_avx512::select_raw_kernel, isa_avx512::demosaic_row, isa_avx512::expand_gray, isa_avx512::select_gray16_kernel, isa_avx512::apply_transform},
+#endif
+};
+static const DecodeIsa* decode_isa = &decode_isas[0];
+
+// Use the best supported tier, or the named one if it is supported; returns false if it is not
+static bool select_decode_isa(const string& forced = {}) {
+    const DecodeIsa* best = &decode_isas[0];
+    for (const auto& isa : decode_isas) {
+        if (!isa.supported()) continue;
+        if (forced == isa.name) {
+            decode_isa = &isa;
+            return true;
+        }
+        best = &isa;
+    }
+    decode_isa = best;
+    return forced.empty();
+}
+
+// Planar counterpart of render_viewport. Rows and planes start on whole bytes (bit_align is
+// ignored); each row is passed to the kernel as one pointer per plane, and a row only shows the
+// 8-pixel groups for which every plane has data.
+static void render_planar(const ViewerState& s, const Preset& preset, const int rows,
+                          vector<uint8_t>& out_pixels, uint32_t& out_rows_rendered) {
+    out_rows_rendered = 0;
+    out_pixels.clear();
+    const size_t size = s.data.size(), start = s.stofs;
+    const int nplanes = s.bpp;
+    if (start >= size || nplanes < 1 || nplanes > max_planes) return;
+    const auto width = max<int>(1, s.width_px);
+    const size_t line = plane_row_bytes(s), stride = row_stride_bits(s) / 8;
+    // distance between planes; interleaved words are de-interleaved into scratch first
+    const size_t plane_step = s.planar == planes_rows ? line
+        : s.planar == planes_whole ? (s.plane_stride > 0 ? s.plane_stride : (size - start) / nplanes) : 0;
+    auto row_pixels = [&](const size_t row) -> int {
+        if (row >= size) return 0;
+        size_t px;
+        if (s.planar == planes_words) {
+            const size_t block = 2 * nplanes, avail = size - row;
+            px = avail / block * 16 + (avail % block >= block - 1 ? 8 : 0);
+        } else {
+            const size_t last = row + (nplanes - 1) * plane_step;
+            px = last < size ? (size - last) * 8 : 0;
+        }
+        return static_cast<int>(min<size_t>(width, px));
+    };
+    uint32_t rows_needed = 0;
+    while (rows_needed < static_cast<uint32_t>(max(rows, 0)) && row_pixels(start + rows_needed * stride) > 0) ++rows_needed;
+    out_rows_rendered = rows_needed;
+    out_pixels.assign(static_cast<size_t>(rows_needed) * width * 4, 0);
+
+    const DecodeProgram prog = compile_preset(preset, nplanes, s.byte_order);
+    const uint32_t* lut = frame_lut(s, preset, prog);
+    const PlanarKernel kernel = decode_isa->planar(s.bit_order_msb);
+    vector<uint8_t> scratch(s.planar == planes_words ? line * nplanes : 0);
+    const uint8_t* planes[max_planes];
+    for (uint32_t y = 0; y < rows_needed; ++y) {
+        const size_t row = start + y * stride;
+        const int count = row_pixels(row);
+        const size_t groups = (count + 7) / 8;
+        for (int p = 0; p < nplanes; ++p) {
+            if (s.planar != planes_words) {
+                planes[p] = &s.data[row + p * plane_step];
+                continue;
+            }
+            uint8_t* plane = &scratch[p * line];
+            for (size_t g = 0; g < groups; ++g) plane[g] = s.data[row + g / 2 * 2 * nplanes + 2 * p + g % 2];
+            planes[p] = plane;
+        }
+        kernel(planes, nplanes, count, &out_pixels[static_cast<size_t>(y) * width * 4], lut);
+    }
+}
+
+// Tiled counterpart of render_viewport: tiles follow each other in the stream and fill the view
+// left to right, width_px / tile width tiles per row. Every tile is decoded whole into a small
+// buffer (a linear tile is just one tile_w * tile_h pixel row for the row kernels) and then
+// copied out a tile row at a time; only complete tiles are shown.
+static void render_tiles(const ViewerState& s, const Preset& preset, const int rows,
+                         vector<uint8_t>& out_pixels, uint32_t& out_rows_rendered) {
+    out_rows_rendered = 0;
+    out_pixels.clear();
+    const bool linear = s.tile_format == tiles_linear;
+    if (s.bpp < 1 || s.bpp > (linear ? max_bpp : max_planes)) return;
+    const int tw = tile_width(s), th = max(1, s.tile_h);
+    const size_t tbits = tile_bits(s);
+    const size_t total_bits = s.data.size() * 8;
+    const size_t start_bit = s.stofs * 8 + (linear ? s.bit_align : 0);
+    if (start_bit >= total_bits) return;
+    const size_t tiles = (total_bits - start_bit) / tbits;
+    const auto width = max<int>(1, s.width_px);
+    const int per_row = max(1, width / tw);
+    const size_t tile_rows = (tiles + per_row - 1) / per_row;
+    const auto rows_needed = static_cast<uint32_t>(min<size_t>(max(rows, 0), tile_rows * th));
+    out_rows_rendered = rows_needed;
+    out_pixels.assign(static_cast<size_t>(rows_needed) * width * 4, 0);
+
+    const TilePlanes tp = tile_planes(s.tile_format, s.bpp, th);
+    const int bpp = linear ? s.bpp : tp.nplanes;
+    const DecodeProgram prog = compile_preset(preset, bpp, s.byte_order);
+    const uint32_t* lut = bpp <= lut_max_bpp ? frame_lut(s, preset, prog) : nullptr;
+    vector<uint8_t> scratch(tbits / 8 + 16);
+    KernelArgs args{lut, scratch.data(), bpp, &prog, false, {}};
+    args.byte_gather = byte_gather_pattern(prog, s.bit_order_msb, args.gather);
+    const RowKernel row_kernel = linear ? decode_isa->select(s, preset, args) : nullptr;
+    const TileKernel tile_kernel = decode_isa->tile(s.bit_order_msb);
+
+    BitRowSource src{s.data.data(), s.data.size(), {}};
+    vector<uint8_t> tile_px(static_cast<size_t>(tw) * th * 4);
+    const size_t row_bytes = static_cast<size_t>(tw) * 4;
+    const size_t copy_bytes = static_cast<size_t>(min(tw, width)) * 4; // a tile may be wider than the view
+    for (uint32_t y0 = 0; y0 < rows_needed; y0 += th) {
+        const size_t first = static_cast<size_t>(y0 / th) * per_row;
+        const int n = static_cast<int>(min<size_t>(per_row, tiles - first));
+        const uint32_t h = min<uint32_t>(th, rows_needed - y0);
+        for (int tx = 0; tx < n; ++tx) {
+            size_t bitpos = start_bit + (first + tx) * tbits;
+            const uint8_t* base = src.row(bitpos, tbits);
+            if (linear) row_kernel(base, bitpos, tw * th, tile_px.data(), args);
+            else tile_kernel(base + bitpos / 8, tp, th, tile_px.data(), lut);
+            uint8_t* dst = &out_pixels[(static_cast<size_t>(y0) * width + static_cast<size_t>(tx) * tw) * 4];
+            for (uint32_t r = 0; r < h; ++r) memcpy(dst + r * width * 4, &tile_px[r * row_bytes], copy_bytes);
+        }
+    }
+}
+
+// Plain rows of `width` pixels, `stride` bits apart, starting at the view's start bit
+static void render_rows(const ViewerState& s, const Preset& preset, const int width, const size_t stride, const int rows,
+                        vector<uint8_t>& out_pixels, uint32_t& out_rows_rendered) {
     const size_t total_bits = s.data.size() * 8;
     const size_t start_bit = s.stofs * 8 + s.bit_align;
-    if (start_bit >= total_bits) {
+    if (start_bit >= total_bits || s.bpp < 1 || s.bpp > max_bpp) {
         out_rows_rendered = 0;
         out_pixels.clear();
         return;
     }
-    const auto width = max<int>(1, s.width_px);
-    const auto pixels_to_render = rows * width;
-    const auto pixels_available = (total_bits - start_bit) / s.bpp;
-    if (pixels_available == 0) {
+    // every row starts at its own bit position, so only rows with at least one whole pixel count
+    if (total_bits - start_bit < static_cast<size_t>(s.bpp)) {
         out_rows_rendered = 0;
         out_pixels.clear();
         return;
     }
-    const auto actual_pixels = min<uint32_t>(pixels_to_render, pixels_available);
-    const auto rows_needed = (actual_pixels + width - 1) / width;
+    const size_t rows_available = (total_bits - start_bit - s.bpp) / stride + 1;
+    const auto rows_needed = static_cast<uint32_t>(min<size_t>(max(rows, 0), rows_available));
     out_rows_rendered = rows_needed;
-    out_pixels.assign(rows_needed * width * 4, 0);
-
-    const uint8_t* raw = s.data.data();
-    size_t bitpos = start_bit;
-
-    for (uint32_t p = 0; p < rows_needed * width; ++p) {
-        const uint32_t x = p % width;
-        const auto y = p / width;
-        uint8_t* dst = &out_pixels[(y * width + x) * 4];
-        if (p >= pixels_available) {
-            // transparent
-            dst[0] = dst[1] = dst[2] = dst[3] = 0;
-            continue;
+    out_pixels.assign(static_cast<size_t>(rows_needed) * width * 4, 0); // pixels past the end of data stay transparent
+
+    BitRowSource src{s.data.data(), s.data.size(), {}};
+    vector<uint8_t> scratch(static_cast<size_t>(width) * s.bpp / 8 + 16);
+    const DecodeProgram prog = compile_preset(preset, s.bpp, s.byte_order);
+    const uint32_t* lut = s.bpp <= lut_max_bpp ? frame_lut(s, preset, prog) : nullptr;
+    KernelArgs args{lut, scratch.data(), s.bpp, &prog, false, {}};
+    args.byte_gather = byte_gather_pattern(prog, s.bit_order_msb, args.gather);
+    const RowKernel kernel = decode_isa->select(s, preset, args);
+
+    for (uint32_t y = 0; y < rows_needed; ++y) {
+        size_t bitpos = start_bit + y * stride;
+        const auto count = static_cast<int>(min<size_t>(width, (total_bits - bitpos) / s.bpp));
+        const uint8_t* base = src.row(bitpos, static_cast<size_t>(count) * s.bpp);
+        uint8_t* dst = &out_pixels[static_cast<size_t>(y) * width * 4];
+        kernel(base, bitpos, count, dst, args);
+    }
+}
+
+// ------------------------------ Deswizzling ------------------------------
+// Every supported swizzle is separable: the stream index of view pixel (x, y) is
+// row_ofs[y] + col_ofs[x] (bit interleaving for Morton and the PS2 tables, block arithmetic
+// otherwise). The source span is decoded linearly at full speed, then copied into place with the
+// two tables; rows are walked in order, so each band of blocks is read while it is still in cache.
+struct SwizzleTables {
+    vector<uint32_t> col_ofs; // per view column
+    vector<size_t> row_ofs;   // per view row
+};
+
+static size_t spread_bits(size_t v) { // bit i -> bit 2i
+    size_t r = 0;
+    for (int i = 0; v; ++i, v >>= 1) r |= (v & 1) << (2 * i);
+    return r;
+}
+
+static SwizzleTables swizzle_tables(const int mode, const int width, const int rows, const int bpp) {
+    SwizzleTables t{vector<uint32_t>(width), vector<size_t>(rows)};
+    if (mode == swizzle_morton) {
+        const size_t side = bit_ceil(static_cast<size_t>(width));
+        for (int x = 0; x < width; ++x) t.col_ofs[x] = static_cast<uint32_t>(spread_bits(x));
+        for (int y = 0; y < rows; ++y) t.row_ofs[y] = y / side * side * side + 2 * spread_bits(y % side);
+    } else if (mode == swizzle_ps2) {
+        // 0,1,4,5,16,17,20,21 across a page's blocks and 0,2,8,10 down; 0,1,4,5,... across a block's
+        // pixels and 0,2,16,18,32,... down (two-row columns of 16 pixels each)
+        const size_t pages_per_row = (width + 63) / 64;
+        for (int x = 0; x < width; ++x) {
+            const int bx = x % 64 / 8, px = x % 8;
+            t.col_ofs[x] = x / 64 * 2048 + ((bx & 1) + (bx & 2) * 2 + (bx & 4) * 4) * 64 + (px & 1) + (px >> 1) * 4;
         }
-        uint64_t pixel_val = 0;
-        if (s.bit_order_msb) {
-            pixel_val = read_bits_msb(raw, total_bits, bitpos, s.bpp);
-        } else {
-            pixel_val = read_bits_lsb(raw, total_bits, bitpos, s.bpp);
-        }
-        bitpos += s.bpp;
-        pixel_val = adjust_endianness_pixel(pixel_val, s.bpp, s.byte_order_le);
-
-        // fields are MSB->LSB in preset.fields
-        int cur_shift = s.bpp;
-        uint8_t r = 255, g = 255, b = 255, a = 255;
-        for (const auto &[name, bits] : preset.fields) {
-            const int use = min(bits, cur_shift);
-            uint64_t rawcomp = 0;
-            if (cur_shift > 0 && use>0) {
-                rawcomp = (pixel_val >> (cur_shift - use)) & ((1ull<<use)-1ull);
-            }
-            cur_shift -= use;
-            const uint8_t val8 = scale_to_8(rawcomp, use);
-            switch (name) {
-                case 'r': r = val8; break;
-                case 'g': g = val8; break;
-                case 'b': b = val8; break;
-                case 'a': a = val8; break;
-                case 'y': r = g = b = val8; break;
-                default: r = g = b = 0;
+        for (int y = 0; y < rows; ++y) {
+            const int by = y % 32 / 8, py = y % 8;
+            t.row_ofs[y] = y / 32 * pages_per_row * 2048 + ((by & 1) * 2 + (by & 2) * 4) * 64 + (py & 1) * 2 + (py >> 1) * 16;
+        }
+    } else { // row-major blocks of bw x bh pixels
+        const int bw = mode == swizzle_psp ? max(1, 128 / bpp) : bpp <= 4 ? 8 : bpp <= 8 ? 8 : 4;
+        const int bh = mode == swizzle_psp ? 8 : bpp <= 4 ? 8 : 4;
+        const size_t block = static_cast<size_t>(bw) * bh, blocks_per_row = (width + bw - 1) / bw;
+        for (int x = 0; x < width; ++x) t.col_ofs[x] = static_cast<uint32_t>(x / bw * block + x % bw);
+        for (int y = 0; y < rows; ++y) t.row_ofs[y] = y / bh * blocks_per_row * block + static_cast<size_t>(y % bh) * bw;
+    }
+    return t;
+}
+
+static void render_swizzled(const ViewerState& s, const Preset& preset, const int rows,
+                            vector<uint8_t>& out_pixels, uint32_t& out_rows_rendered) {
+    out_rows_rendered = 0;
+    out_pixels.clear();
+    const size_t total_bits = s.data.size() * 8, start_bit = s.stofs * 8 + s.bit_align;
+    if (start_bit >= total_bits || s.bpp < 1 || s.bpp > max_bpp) return;
+    const size_t available = (total_bits - start_bit) / s.bpp; // whole pixels in the stream
+    const auto width = max<int>(1, s.width_px);
+    const SwizzleTables t = swizzle_tables(s.swizzle, width, max(rows, 0), s.bpp);
+    // rows are visible while their first pixel exists (row_ofs only grows)
+    uint32_t rows_needed = 0;
+    while (rows_needed < t.row_ofs.size() && t.row_ofs[rows_needed] < available) ++rows_needed;
+    if (!rows_needed) return;
+    const size_t span = min(available, t.row_ofs[rows_needed - 1] + ranges::max(t.col_ofs) + 1);
+
+    // GameCube RGBA8: each pixel is put back together as A, R, G, B before decoding (whole blocks,
+    // as the GB half of the span's last block lies past its end, + a byte for the bit offset)
+    const ViewerState* src = &s;
+    static ViewerState regrouped;
+    if (s.swizzle == swizzle_gc && s.bpp == 32) {
+        const uint8_t* in = s.data.data() + s.stofs;
+        vector<uint8_t> bytes(in, in + min((span + 15) / 16 * 64 + 1, s.data.size() - s.stofs));
+        for (size_t b = 0; b + 64 <= bytes.size(); b += 64)
+            for (size_t i = 0; i < 16; ++i) {
+                const uint8_t px[4] = {in[b + 2 * i], in[b + 2 * i + 1], in[b + 32 + 2 * i], in[b + 33 + 2 * i]};
+                memcpy(&bytes[b + 4 * i], px, 4);
             }
+        static_cast<ViewSettings&>(regrouped) = s;
+        regrouped.stofs = 0;
+        regrouped.data = ByteSource(std::move(bytes));
+        src = &regrouped;
+    }
+
+    // the source span as one linear run of pixels; reused between frames since it can be large
+    static vector<uint8_t> linear;
+    uint32_t linear_rows = 0;
+    render_rows(*src, preset, width, static_cast<size_t>(width) * s.bpp, static_cast<int>((span + width - 1) / width), linear, linear_rows);
+    out_rows_rendered = rows_needed;
+    out_pixels.assign(static_cast<size_t>(rows_needed) * width * 4, 0);
+    for (uint32_t y = 0; y < rows_needed; ++y)
+        decode_isa->swizzle(linear.data(), span, t.row_ofs[y], t.col_ofs.data(), width, &out_pixels[static_cast<size_t>(y) * width * 4]);
+}
+
+// ------------------------------ Block-compressed textures ------------------------------
+// Blocks are laid out row-major, ceil(width / 4) per block row; only complete blocks are shown.
+// Each block row is decoded into scratch at the padded width, then copied out clipped to the view.
+static void render_blocks(const ViewerState& s, const int rows, vector<uint8_t>& out_pixels, uint32_t& out_rows_rendered) {
+    out_rows_rendered = 0;
+    out_pixels.clear();
+    const size_t size = s.data.size(), start = s.stofs;
+    if (start >= size) return;
+    const auto width = max<int>(1, s.width_px);
+    const int per_row = (width + 3) / 4, bytes = block_bytes(s.block_format);
+    const size_t blocks = (size - start) / bytes;
+    const size_t block_rows = (blocks + per_row - 1) / per_row;
+    const auto rows_needed = static_cast<uint32_t>(min<size_t>(max(rows, 0), block_rows * 4));
+    out_rows_rendered = rows_needed;
+    out_pixels.assign(static_cast<size_t>(rows_needed) * width * 4, 0);
+
+    const BlockKernel kernel = decode_isa->block(s.block_format);
+    const size_t pitch = static_cast<size_t>(per_row) * 16;
+    vector<uint8_t> scratch(pitch * 4);
+    for (uint32_t y0 = 0; y0 < rows_needed; y0 += 4) {
+        const size_t first = static_cast<size_t>(y0 / 4) * per_row;
+        const int n = static_cast<int>(min<size_t>(per_row, blocks - first));
+        kernel(&s.data[start + first * bytes], n, scratch.data(), pitch);
+        const size_t copy = static_cast<size_t>(min(width, n * 4)) * 4;
+        for (uint32_t r = 0; r < 4 && y0 + r < rows_needed; ++r)
+            memcpy(&out_pixels[static_cast<size_t>(y0 + r) * width * 4], &scratch[r * pitch], copy);
+    }
+}
+
+// ------------------------------ YUV frames ------------------------------
+// Rows start every row stride bytes (packed width * 2 or, for the planar formats, width bytes of
+// luma); planar chroma rows are shared by two luma rows and sit at chroma_ofs / chroma2_ofs with
+// the same stride (NV12) or half of it (I420). Only rows whose luma and chroma all exist are shown.
+static void render_yuv(const ViewerState& s, const int rows, vector<uint8_t>& out_pixels, uint32_t& out_rows_rendered) {
+    out_rows_rendered = 0;
+    out_pixels.clear();
+    const size_t size = s.data.size(), start = s.stofs;
+    if (start >= size) return;
+    const auto width = max<int>(1, s.width_px);
+    const bool packed = s.yuv_format == yuv_yuyv || s.yuv_format == yuv_uyvy;
+    const size_t pairs = (width + 1) / 2;
+    const size_t stride = max<size_t>(1, row_stride_bits(s) / 8);
+    const size_t chroma_stride = s.yuv_format == yuv_i420 ? (stride + 1) / 2 : stride;
+    const size_t chroma_bytes = s.yuv_format == yuv_i420 ? pairs : pairs * 2;
+    auto fits = [size](const size_t ofs, const size_t n) { return ofs <= size && n <= size - ofs; };
+    const size_t chroma = start + s.chroma_ofs, chroma2 = start + s.chroma2_ofs;
+    auto row_fits = [&](const size_t y) {
+        if (packed) return fits(start + y * stride, pairs * 4);
+        return fits(start + y * stride, width) && fits(chroma + y / 2 * chroma_stride, chroma_bytes)
+            && (s.yuv_format != yuv_i420 || fits(chroma2 + y / 2 * chroma_stride, chroma_bytes));
+    };
+    uint32_t rows_needed = 0;
+    while (rows_needed < static_cast<uint32_t>(max(rows, 0)) && row_fits(rows_needed)) ++rows_needed;
+    out_rows_rendered = rows_needed;
+    out_pixels.assign(static_cast<size_t>(rows_needed) * width * 4, 0);
+
+    const YuvCoeffs c = yuv_coeffs(s.yuv_bt709, s.yuv_full_range);
+    const YuvKernel kernel = decode_isa->yuv(s.yuv_format);
+    const uint8_t* data = s.data.data();
+    for (uint32_t y = 0; y < rows_needed; ++y) {
+        const uint8_t* luma = data + start + y * stride;
+        const uint8_t* u = packed ? nullptr : data + chroma + y / 2 * chroma_stride;
+        const uint8_t* v = s.yuv_format == yuv_i420 ? data + chroma2 + y / 2 * chroma_stride : nullptr;
+        kernel(luma, u, v, width, &out_pixels[static_cast<size_t>(y) * width * 4], c);
+    }
+}
+
+// ------------------------------ Sensor RAW frames ------------------------------
+// Rows are unpacked and levelled into padded 8-bit lines (edges mirrored, which keeps the Bayer
+// phase), then demosaiced from the lines above and below. The row after the view is read too if
+// the file has it, so the bottom row interpolates like the others.
+static void render_raw(const ViewerState& s, const int rows, vector<uint8_t>& out_pixels, uint32_t& out_rows_rendered) {
+    out_rows_rendered = 0;
+    out_pixels.clear();
+    const size_t size = s.data.size(), start = s.stofs;
+    if (start >= size) return;
+    const auto width = max<int>(1, s.width_px);
+    const size_t row_bytes = raw_row_bytes(s.raw_format, width);
+    const size_t stride = max<size_t>(1, row_stride_bits(s) / 8);
+    uint32_t avail = 0; // rows in the file, up to one past the view
+    while (avail <= static_cast<uint32_t>(max(rows, 0)) && start + avail * stride + row_bytes <= size) ++avail;
+    const uint32_t rows_needed = min(avail, static_cast<uint32_t>(max(rows, 0)));
+    out_rows_rendered = rows_needed;
+    out_pixels.assign(static_cast<size_t>(rows_needed) * width * 4, 0);
+    if (!rows_needed) return;
+
+    const RawLevels levels = raw_levels(s);
+    const RawKernel unpack = decode_isa->raw(s.raw_format);
+    const size_t line_size = width + 2 + 16;
+    static vector<uint8_t> line_buf;
+    line_buf.assign(line_size * 3, 0);
+    auto load_line = [&](const uint32_t y, uint8_t* line) { // line[1..width] = row y
+        unpack(s.data.data() + start + y * stride, width, line + 1, levels);
+        line[0] = line[width > 1 ? 2 : 1];
+        line[width + 1] = line[width > 1 ? width - 1 : 1];
+    };
+    uint8_t* up = line_buf.data();
+    uint8_t* cur = up + line_size;
+    uint8_t* down = cur + line_size;
+    if (s.bayer == bayer_off) {
+        for (uint32_t y = 0; y < rows_needed; ++y) {
+            load_line(y, cur);
+            decode_isa->gray(cur + 1, width, &out_pixels[static_cast<size_t>(y) * width * 4]);
+        }
+        return;
+    }
+    static constexpr const char* patterns[] = {"", "RGGB", "BGGR", "GRBG", "GBRG"};
+    const char* pattern = patterns[s.bayer];
+    auto mirror = [n = static_cast<int64_t>(avail)](const int64_t y) { return static_cast<uint32_t>(y < 0 ? min<int64_t>(1, n - 1) : y >= n ? max<int64_t>(0, n - 2) : y); };
+    load_line(mirror(-1), up);
+    load_line(0, cur);
+    for (uint32_t y = 0; y < rows_needed; ++y) {
+        load_line(mirror(y + 1), down);
+        const char* sites = pattern + y % 2 * 2;
+        decode_isa->demosaic(up + 1, cur + 1, down + 1, width, sites[0] == 'R' || sites[1] == 'R', sites[0] == 'G',
+                             &out_pixels[static_cast<size_t>(y) * width * 4]);
+        uint8_t* const done = up;
+        up = cur;
+        cur = down;
+        down = done;
+    }
+}
+
+// ------------------------------ Deep gray frames ------------------------------
+// The auto windows come from a histogram of the visible rows. It is kept between frames and,
+// while only the start offset moves by whole rows, updated by the rows that scrolled in and out.
+struct GrayHistogram {
+    tuple<unsigned, size_t, int, int, int, bool> key; // everything but the first row and row count
+    int64_t first{}; // file offset of the first counted row
+    uint32_t rows{};
+    uint64_t total{};
+    vector<uint32_t> bins = vector<uint32_t>(65536);
+    // samples of the counted rows, so they can be taken out again once the window they were read
+    // from has moved on; file row r (in strides) is kept in slot r % slots
+    vector<uint16_t> counted;
+    uint32_t slots{};
+};
+
+static void update_gray_histogram(GrayHistogram& h, const ViewerState& s, const size_t start, const uint32_t rows, const size_t stride,
+                                  const int bits, const bool big_endian, const Gray16Kernel unpack, vector<uint16_t>& samples) {
+    const auto width = max<int>(1, s.width_px);
+    const auto key = make_tuple(s.data_version, stride, width, s.deep_gray, bits, big_endian);
+    const auto stride_i = static_cast<int64_t>(stride);
+    const int64_t first = s.data_base + static_cast<int64_t>(start);
+    const int64_t moved = first - h.first;
+    // new rows as indices relative to the old first row
+    int64_t new_lo = moved / stride_i, new_hi = new_lo + rows;
+    if (h.key != key || moved % stride_i || new_lo >= h.rows || new_hi <= 0 || rows > h.slots) { // start over
+        h.key = key;
+        h.first = first;
+        h.rows = 0;
+        h.total = 0;
+        ranges::fill(h.bins, 0u);
+        h.slots = max(h.slots, rows);
+        h.counted.resize(static_cast<size_t>(h.slots) * width);
+        new_lo = 0;
+        new_hi = rows;
+    }
+    auto count_row = [&](const int64_t r, const int delta) {
+        uint16_t* row = &h.counted[static_cast<size_t>((h.first / stride_i + r) % h.slots) * width];
+        if (delta > 0) {
+            unpack(s.data.data() + (h.first - s.data_base) + r * stride_i, width, bits, samples.data());
+            copy_n(samples.data(), width, row);
+        }
+        for (int x = 0; x < width; ++x) h.bins[row[x]] += delta;
+        h.total += static_cast<int64_t>(delta) * width;
+    };
+    for (int64_t r = 0; r < h.rows; ++r)
+        if (r < new_lo || r >= new_hi) count_row(r, -1);
+    for (int64_t r = new_lo; r < new_hi; ++r)
+        if (r < 0 || r >= h.rows) count_row(r, 1);
+    h.first = first;
+    h.rows = rows;
+}
+
+static void render_deep_gray(const ViewerState& s, const int rows, vector<uint8_t>& out_pixels, uint32_t& out_rows_rendered) {
+    out_rows_rendered = 0;
+    out_pixels.clear();
+    const size_t size = s.data.size(), start = s.stofs;
+    if (start >= size) return;
+    const auto width = max<int>(1, s.width_px);
+    const size_t row_bytes = static_cast<size_t>(width) * 2;
+    const size_t stride = max<size_t>(1, row_stride_bits(s) / 8);
+    uint32_t rows_needed = 0;
+    while (rows_needed < static_cast<uint32_t>(max(rows, 0)) && start + rows_needed * stride + row_bytes <= size) ++rows_needed;
+    out_rows_rendered = rows_needed;
+    out_pixels.assign(static_cast<size_t>(rows_needed) * width * 4, 0);
+    if (!rows_needed) return;
+
+    const bool is_signed = s.deep_gray == deep_signed;
+    const int bits = clamp(s.deep_bits, 9, 16), zero = is_signed ? 0x8000 : 0; // order-preserving value of 0
+    // big-endian containers: the first byte is on top when it is for 16-bit pixels (MSB-first
+    // streams hold the value big-endian, then the byte order permutes it)
+    const int low = byte_order_source(s.byte_order, 0, 2);
+    const bool big_endian = (s.bit_order_msb ? 1 - low : low) == 1;
+    const Gray16Kernel unpack = decode_isa->gray16(big_endian, is_signed);
+    static vector<uint16_t> samples;
+    static vector<uint8_t> levelled;
+    samples.resize(width + 8);
+    levelled.resize(width + 16);
+
+    int lo, hi;
+    if (s.window_mode == window_manual) {
+        lo = clamp(zero + s.window_level - s.window_width / 2, 0, 65534);
+        hi = clamp(lo + max(1, s.window_width), lo + 1, 65535);
+    } else {
+        static GrayHistogram hist;
+        update_gray_histogram(hist, s, start, rows_needed, stride, bits, big_endian, unpack, samples);
+        // first and last values with more than `skip` values below / above them
+        const uint64_t skip = s.window_mode == window_percentile ? hist.total / 100 : 0;
+        uint64_t below = 0, above = 0;
+        lo = 0;
+        while (lo < 65535 && (below += hist.bins[lo]) <= skip) ++lo;
+        hi = 65535;
+        while (hi > 0 && (above += hist.bins[hi]) <= skip) --hi;
+        if (hi <= lo) hi = min(lo + 1, 65535), lo = hi - 1;
+    }
+    const RawLevels levels = levels_between(lo, hi);
+    // the order-preserving values are native 16-bit words: RAW16 as they are on a little-endian
+    // host, byte-swapped into it on a big-endian one
+    const RawKernel level = decode_isa->raw(raw_16);
+    for (uint32_t y = 0; y < rows_needed; ++y) {
+        unpack(s.data.data() + start + y * stride, width, bits, samples.data());
+        if constexpr (endian::native == endian::big)
+            for (int x = 0; x < width; ++x) samples[x] = byteswap(samples[x]);
+        level(reinterpret_cast<const uint8_t*>(samples.data()), width, levelled.data(), levels);
+        decode_isa->gray(levelled.data(), width, &out_pixels[static_cast<size_t>(y) * width * 4]);
+    }
+}
+
+// ------------------------------ Float frames ------------------------------
+// Auto range maps the finite colour values of the visible rows onto 0..255; that min/max pass is
+// cached and only redone when the visible data changes, not when e.g. the palette does.
+static void render_float(const ViewerState& s, const int rows, vector<uint8_t>& out_pixels, uint32_t& out_rows_rendered) {
+    out_rows_rendered = 0;
+    out_pixels.clear();
+    const size_t size = s.data.size(), start = s.stofs;
+    if (start >= size) return;
+    const auto width = max<int>(1, s.width_px);
+    const size_t row_bytes = static_cast<size_t>(width) * float_pixel_bytes(s.float_format);
+    const size_t stride = max<size_t>(1, row_stride_bits(s) / 8);
+    uint32_t rows_needed = 0;
+    while (rows_needed < static_cast<uint32_t>(max(rows, 0)) && start + rows_needed * stride + row_bytes <= size) ++rows_needed;
+    out_rows_rendered = rows_needed;
+    out_pixels.assign(static_cast<size_t>(rows_needed) * width * 4, 0);
+    const uint8_t* data = s.data.data() + start;
+
+    float offset = 0.0f, scale = 255.0f * exp2f(s.float_exposure);
+    if (s.float_auto_range) {
+        static struct {
+            tuple<unsigned, int64_t, int, int, size_t, uint32_t> key;
+            float lo{}, hi{};
+        } range;
+        const auto key = make_tuple(s.data_version, s.data_base + static_cast<int64_t>(start), s.float_format, width, stride, rows_needed);
+        if (range.key != key) {
+            range.key = key;
+            range.lo = numeric_limits<float>::infinity();
+            range.hi = -numeric_limits<float>::infinity();
+            for (uint32_t y = 0; y < rows_needed; ++y)
+                decode_isa->float_range(data + y * stride, static_cast<size_t>(width) * float_channels(s.float_format),
+                                        s.float_format, range.lo, range.hi);
+            if (range.lo > range.hi) range.lo = 0.0f, range.hi = 1.0f; // nothing finite
         }
-        dst[0] = r; dst[1] = g; dst[2] = b; dst[3] = a;
+        scale = 255.0f / (range.hi > range.lo ? range.hi - range.lo : 1.0f);
+        offset = -range.lo;
     }
+    const FloatKernel kernel = decode_isa->float_row(s.float_format);
+    for (uint32_t y = 0; y < rows_needed; ++y)
+        kernel(data + y * stride, width, offset, scale, &out_pixels[static_cast<size_t>(y) * width * 4]);
+}
+
+// Decode a viewport (width x rows) into an RGBA buffer (row-major), or into an index frame in indexed mode
+static void decode_viewport(const ViewerState& s, const Preset& preset, const int rows,
+                            vector<uint8_t>& out_pixels, uint32_t& out_rows_rendered) {
+    if (s.tile_format != tiles_off) render_tiles(s, preset, rows, out_pixels, out_rows_rendered);
+    else if (s.block_format != blocks_off) render_blocks(s, rows, out_pixels, out_rows_rendered);
+    else if (s.yuv_format != yuv_off) render_yuv(s, rows, out_pixels, out_rows_rendered);
+    else if (s.raw_format != raw_off) render_raw(s, rows, out_pixels, out_rows_rendered);
+    else if (s.deep_gray != deep_off) render_deep_gray(s, rows, out_pixels, out_rows_rendered);
+    else if (s.float_format != float_off) render_float(s, rows, out_pixels, out_rows_rendered);
+    else if (s.planar != planes_off) render_planar(s, preset, rows, out_pixels, out_rows_rendered);
+    else if (s.swizzle != swizzle_off) render_swizzled(s, preset, rows, out_pixels, out_rows_rendered);
+    else render_rows(s, preset, max(1, s.width_px), row_stride_bits(s), rows, out_pixels, out_rows_rendered);
 }
 
+// ------------------------------ Decode window ------------------------------
+// Frames are decoded from one buffer in memory. For a cached file, or when there are transforms,
+// that is a copy of just the bytes the frame can reach: the rows from the start offset on, plus
+// whatever the layout reaches beyond them (tile rows, block rows, swizzle span), generously
+// rounded up. Anything past that is treated as the end of the file. Whole planes and planar YUV
+// chroma are copied as separate parts, however far apart they are in the file.
+static size_t visible_span(const ViewerState& s, const int rows) {
+    const size_t width = max(1, s.width_px);
+    const size_t n = max(rows, 0) + 1; // RAW demosaic reads the row below the view
+    const size_t stride = (row_stride_bits(s) + 7) / 8;
+    // + a block row, + one row of the widest pixels (16 bytes) for strides narrower than a row
+    size_t span = (n + 4) * stride + width * 16 + 8;
+    if (s.tile_format != tiles_off) {
+        const size_t tile_row = tile_bits(s) * max<size_t>(1, width / tile_width(s)) / 8;
+        span = (n / max(1, s.tile_h) + 2) * tile_row;
+    }
+    if (s.swizzle != swizzle_off && s.bpp >= 1 && s.bpp <= max_bpp) {
+        const SwizzleTables t = swizzle_tables(s.swizzle, static_cast<int>(width), max(rows, 0), s.bpp);
+        // + the GB half of a GameCube RGBA8 block
+        if (!t.row_ofs.empty()) span = max(span, ((t.row_ofs.back() + ranges::max(t.col_ofs) + 1) * s.bpp + 7) / 8 + 64);
+    }
+    return span;
+}
+
+// Where the parts of a frame start, relative to the start offset
+struct FrameParts {
+    int count{1};
+    array<size_t, max_planes> ofs{};
+};
+
+static FrameParts frame_parts(const ViewerState& s) {
+    FrameParts f;
+    const size_t size = s.data.size(), start = min<size_t>(s.stofs, size);
+    if (s.tile_format == tiles_off && s.block_format == blocks_off && (s.yuv_format == yuv_nv12 || s.yuv_format == yuv_i420)) {
+        f.count = s.yuv_format == yuv_i420 ? 3 : 2;
+        f.ofs[1] = s.chroma_ofs;
+        f.ofs[2] = s.chroma2_ofs;
+    } else if (s.planar == planes_whole) {
+        f.count = clamp(s.bpp, 1, max_planes);
+        const size_t step = s.plane_stride > 0 ? s.plane_stride : (size - start) / f.count;
+        for (int p = 0; p < f.count; ++p) f.ofs[p] = p * step;
+    }
+    return f;
+}
+
+// The state to decode from: s itself when its bytes are in memory and untransformed, otherwise
+// the window copy starting at offset 0. The copy is only redone when the window, the data or the
+// transforms change, or when blocks it was missing have come in. It keeps its data_version while
+// only the window moves over fully loaded bytes, so caches keyed on data_version and file offset
+// (data_base + offset) carry over between scroll steps. `missing` gets the file bytes that aren't
+// loaded yet (they read as zeros).
+static const ViewerState& window_view(const ViewerState& s, const int rows, vector<BlockCache::Range>& missing) {
+    missing.clear();
+    if (s.transforms.empty() && s.data.data()) return s;
+    static struct {
+        ViewerState view;
+        tuple<unsigned, const uint8_t*, size_t, size_t, array<size_t, max_planes>, size_t, int> key;
+        vector<Transform> chain;
+        vector<BlockCache::Range> missing;
+        unsigned generation{};
+        array<size_t, max_planes> at{}; // where each part starts in the copy
+    } w;
+    const size_t size = s.data.size(), start = min<size_t>(s.stofs, size);
+    const size_t span = visible_span(s, rows), row_bytes = max<size_t>(1, row_stride_bits(s) / 8);
+    const FrameParts parts = frame_parts(s);
+    static_cast<ViewSettings&>(w.view) = s;
+    w.view.stofs = 0;
+    const auto key = make_tuple(s.data_version, s.data.data(), start, span, parts.ofs, row_bytes, parts.count);
+    const unsigned generation = s.data.cache() ? s.data.cache()->generation() : 0;
+    if (w.key != key || w.chain != s.transforms || (!w.missing.empty() && w.generation != generation)) {
+        // the same bytes at the same file offsets, unless something other than the window moved
+        // or zeros stood in for missing bytes
+        bool same = w.chain == s.transforms && w.missing.empty() && w.view.data_version != 0;
+        same = same && get<0>(w.key) == get<0>(key) && get<1>(w.key) == get<1>(key);
+        same = same && get<4>(w.key) == get<4>(key) && get<5>(w.key) == get<5>(key) && get<6>(w.key) == get<6>(key);
+        w.key = key;
+        w.chain = s.transforms;
+        w.missing.clear();
+        w.generation = generation;
+        // the parts are copied in file order as runs of file bytes, parts less than a span apart
+        // sharing one, so each part's bytes end in the copy where they end in the file
+        array<int, max_planes> order{};
+        iota(order.begin(), order.begin() + parts.count, 0);
+        stable_sort(order.begin(), order.begin() + parts.count, [&](const int a, const int b) { return parts.ofs[a] < parts.ofs[b]; });
+        vector<BlockCache::Range> runs;
+        size_t copied = 0; // bytes in the runs before the last
+        for (int i = 0; i < parts.count; ++i) {
+            const int p = order[i];
+            const size_t ofs = min(size, start + parts.ofs[p]), end = ofs + min(span, size - ofs);
+            if (!runs.empty() && ofs > runs.back().second) copied += runs.back().second - runs.back().first;
+            if (runs.empty() || ofs > runs.back().second) runs.emplace_back(ofs, end);
+            else runs.back().second = max(runs.back().second, end);
+            w.at[p] = copied + ofs - runs.back().first;
+        }
+        // a window needing more blocks than the cache holds would never finish loading; it is read
+        // while we wait instead
+        size_t blocks = 0;
+        for (const auto& [ofs, end] : runs)
+            if (end > ofs) blocks += (end - 1) / BlockCache::block_size - ofs / BlockCache::block_size + 1;
+        const bool wait = blocks * BlockCache::block_size > BlockCache::budget;
+        vector<uint8_t> bytes(copied + runs.back().second - runs.back().first);
+        uint8_t* dst = bytes.data();
+        for (const auto& [ofs, end] : runs) {
+            if (wait) s.data.read(ofs, end - ofs, dst);
+            else s.data.read_loaded(ofs, end - ofs, dst, w.missing);
+            for (const auto& t : s.transforms) decode_isa->transform(t, dst, end - ofs, ofs, row_bytes);
+            dst += end - ofs;
+        }
+        w.view.data = ByteSource(std::move(bytes));
+        w.view.data_base = static_cast<int64_t>(start);
+        if (!same || !w.missing.empty()) w.view.data_version = ++ViewerState::versions;
+    }
+    // parts of the same size, as whole planes are, keep an even stride in the copy
+    w.view.plane_stride = static_cast<int64_t>(parts.count > 1 ? w.at[1] : span);
+    w.view.chroma_ofs = static_cast<int64_t>(w.at[1]);
+    w.view.chroma2_ofs = static_cast<int64_t>(w.at[2]);
+    missing = w.missing;
+    return w.view;
+}
+
+// Rows whose bytes are still loading are covered with a checkerboard (by row stride, which for
+// tiles and blocks is the average per pixel row)
+static void draw_placeholders(const ViewerState& s, const vector<BlockCache::Range>& missing, vector<uint8_t>& pixels,
+                              const uint32_t rows) {
+    const size_t width = max(1, s.width_px), stride = max<size_t>(1, row_stride_bits(s) / 8);
+    const size_t start = s.stofs;
+    const FrameParts parts = frame_parts(s);
+    for (uint32_t y = 0; y < rows; ++y) {
+        bool loading = false;
+        for (int p = 0; p < parts.count && !loading; ++p) {
+            const size_t first = start + parts.ofs[p] + y * stride, last = first + stride;
+            for (const auto& [a, b] : missing) loading |= first < b && a < last;
+        }
+        if (!loading) continue;
+        uint8_t* row = &pixels[y * width * 4];
+        for (size_t x = 0; x < width; ++x) {
+            const uint8_t v = (x / 8 + y / 8) % 2 ? 0x50 : 0x38;
+            const uint8_t px[4] = {v, v, v, 255};
+            memcpy(row + x * 4, px, 4);
+        }
+    }
+}
+
+// Indexed frames keep their index frame, so palette edits only redo the palette lookup
+static void render_indexed(const ViewerState& file, const ViewerState& s, const Preset& preset, const int rows,
+                           vector<uint8_t>& out_pixels, uint32_t& out_rows_rendered, vector<BlockCache::Range>& missing) {
+    // the index frame depends on everything except the palette settings
+    static struct {
+        tuple<unsigned, const uint8_t*, size_t, int64_t, int, int, int, int, int, int64_t, int, int, int, int, bool, int> key;
+        vector<uint8_t> indices;
+        uint32_t rows{};
+    } frame;
+    const auto key = make_tuple(s.data_version, s.data.data(), s.data.size(), s.stofs, s.width_px, s.bpp, s.bit_align,
+                                s.row_stride_bits, s.planar, s.plane_stride, s.swizzle, s.tile_format, s.tile_w, s.tile_h,
+                                s.bit_order_msb, rows);
+    if (frame.indices.empty() || frame.key != key) {
+        decode_viewport(s, preset, rows, frame.indices, frame.rows);
+        frame.key = key;
+    }
+    out_rows_rendered = frame.rows;
+    out_pixels.resize(frame.indices.size());
+    decode_isa->palette(frame.indices.data(), frame.indices.size() / 4, out_pixels.data(), palette_table(file, missing));
+}
+
+// Render a viewport (width x rows) into an RGBA buffer (row-major). Palettes are read from the
+// file as it is, the transforms only apply to the pixels.
+static void render_viewport(const ViewerState& file, const Preset& preset, const int rows,
+                            vector<uint8_t>& out_pixels, uint32_t& out_rows_rendered) {
+    static vector<BlockCache::Range> missing;
+    const ViewerState& s = window_view(file, rows, missing);
+    if (!s.indexed || s.bpp > palette_max_bpp || s.block_format != blocks_off || s.yuv_format != yuv_off
+        || s.raw_format != raw_off || s.deep_gray != deep_off || s.float_format != float_off)
+        decode_viewport(s, preset, rows, out_pixels, out_rows_rendered);
+    else
+        render_indexed(file, s, preset, rows, out_pixels, out_rows_rendered, missing);
+    if (!missing.empty()) draw_placeholders(file, missing, out_pixels, out_rows_rendered);
+}
+
+// ------------------------------ Readahead ------------------------------
+// Watches the start offset from frame to frame. Once it has moved the same way twice in a row,
+// the blocks the next screens will need are queued with the loader, behind those on screen: as
+// many as the current speed covers in lookahead_seconds, at least two screens and at most half
+// the cache budget, but never more than fits next to the blocks on screen (so reading ahead
+// can't evict them). A pause or a change of direction starts over.
+struct Readahead {
+    static constexpr double lookahead_seconds = 0.5;
+
+    unsigned data_version{};
+    int64_t last_ofs{-1};
+    chrono::steady_clock::time_point last_move;
+    int direction{}, streak{};
+    double rate{}; // bytes per second, smoothed
+
+    void update(const ViewerState& s, const int rows) {
+        BlockCache* cache = s.data.cache();
+        if (!cache) return;
+        const auto now = chrono::steady_clock::now();
+        if (s.data_version != data_version || last_ofs < 0) {
+            *this = {s.data_version, s.stofs, now};
+            return;
+        }
+        const int64_t delta = s.stofs - last_ofs;
+        if (!delta) return;
+        const double dt = max(1e-3, chrono::duration<double>(now - last_move).count());
+        const double speed = static_cast<double>(abs(delta)) / dt;
+        const int dir = delta > 0 ? 1 : -1;
+        if (dir != direction || dt > 1.0) {
+            direction = dir;
+            streak = 0;
+            rate = speed;
+        } else {
+            rate = 0.7 * rate + 0.3 * speed;
+        }
+        last_ofs = s.stofs;
+        last_move = now;
+        if (++streak < 2) return;
+
+        const size_t screen = visible_span(s, rows), start = min<size_t>(s.stofs, s.data.size());
+        const size_t budget = BlockCache::budget, block = BlockCache::block_size;
+        // the screen and the read-ahead each touch up to a partial block at either end
+        const size_t room = budget - min(budget, screen + 3 * block);
+        const size_t ahead = min(clamp(static_cast<size_t>(rate * lookahead_seconds), 2 * screen, max(2 * screen, budget / 2)), room);
+        if (direction > 0) cache->prefetch(start + screen, ahead, false);
+        else cache->prefetch(start - min(start, ahead), min(start, ahead), true);
+    }
+};
+
+#ifndef RAWVIEWER_NO_GUI
 // Save RGBA buffer to PNG (stb)
 static bool save_png(const string &filename, const int w, const int h, const vector<uint8_t>& buf) {
     if (static_cast<int>(buf.size()) < w*h*4) return false;
@@ -209,24 +2010,23 @@ static bool save_png(const string &filename, const int w, const int h, const vec
     const int res = stbi_write_png(filename.c_str(), w, h, 4, buf.data(), stride);
     return res != 0;
 }
+#endif
 
 // Helper: load file into ViewerState
 static bool load_file_into(ViewerState &S, const string &path) {
     if (path.empty()) return false;
-    ifstream in(path, ios::binary | ios::ate);
-    if (!in) return false;
-    const auto sz = in.tellg();
-    in.seekg(0, ios::beg);
-    vector<uint8_t> tmp((size_t)sz);
-    in.read(reinterpret_cast<char *>(tmp.data()), sz);
-    S.data.swap(tmp);
+    auto src = ByteSource::open(path);
+    if (!src) return false;
+    S.data = std::move(*src);
     S.filename = path;
+    S.data_version = ++ViewerState::versions;
     S.stofs = 0;
     S.bit_align = 0;
     return true;
 }
 
 // ------------------------------ Main program ------------------------------
+#ifndef RAWVIEWER_NO_GUI
 int main(int argc, char** argv) {
     // Init SDL + GL + ImGui
     if (SDL_Init(SDL_INIT_VIDEO|SDL_INIT_TIMER|SDL_INIT_EVENTS) != 0) {
@@ -272,10 +2072,11 @@ int main(int argc, char** argv) {
     ImGui_ImplSDL2_InitForOpenGL(window, gl_context);
     ImGui_ImplOpenGL3_Init("#version 130");
 
-    // Prepare presets
+    // Prepare presets: the built-in ones, then those from the preset file
+    string preset_path = preset_file_name;
     auto presets = build_presets();
+    vector<string> preset_errors;
     ViewerState S;
-    S.data.clear();
 
     //bool show_demo = false;
 
@@ -291,12 +2092,45 @@ int main(int argc, char** argv) {
     bool save_requested = false;
     bool load_requested = false;
     vector<uint8_t> rgba_buf;
+    int yuv_frame_h = 1080; // only used to place the planar YUV chroma planes
+    bool hex_offsets = false; // offsets are shown and typed in hex
+    int cache_budget_mb = static_cast<int>(BlockCache::budget >> 20);
+    Readahead readahead;
+    // 64-bit file offset entry, decimal or hex, never negative
+    auto input_offset = [&hex_offsets](const char* label, int64_t& v) {
+        const int64_t step = 1, step_fast = hex_offsets ? 0x100 : 100;
+        ImGui::InputScalar(label, ImGuiDataType_S64, &v, &step, &step_fast, hex_offsets ? "%llX" : "%lld",
+                           hex_offsets ? ImGuiInputTextFlags_CharsHexadecimal : ImGuiInputTextFlags_None);
+        v = max<int64_t>(v, 0);
+    };
 
-    if (argc > 1) {
-        //put the filename into path:
-        path = argv[1];
-        load_requested = true;
+    // decode kernel tier: best supported unless RAWVIEWER_ISA or --isa=<name> says otherwise
+    string forced_isa;
+    if (const char* env_isa = getenv("RAWVIEWER_ISA")) forced_isa = env_isa;
+    for (int i = 1; i < argc; ++i) {
+        const string arg = argv[i];
+        if (arg.starts_with("--isa=")) {
+            forced_isa = arg.substr(6);
+        } else if (arg.starts_with("--presets=")) {
+            preset_path = arg.substr(10);
+        } else {
+            //put the filename into path:
+            path = arg;
+            load_requested = true;
+        }
+    }
+    if (!select_decode_isa(forced_isa)) {
+        cerr << "Decode kernels \"" << forced_isa << "\" not supported here, using " << decode_isa->name << endl;
     }
+    auto reload_presets = [&] {
+        const string selected = presets[S.preset_idx].label;
+        presets = build_presets();
+        preset_errors = load_preset_file(preset_path, presets);
+        for (const auto& e : preset_errors) cerr << e << endl;
+        const auto it = ranges::find(presets, selected, &Preset::label);
+        S.preset_idx = it != presets.end() ? static_cast<int>(it - presets.begin()) : min(S.preset_idx, static_cast<int>(presets.size()) - 1);
+    };
+    reload_presets();
 
 
     // main loop
@@ -322,21 +2156,18 @@ int main(int argc, char** argv) {
             // keyboard navigation (when ImGui not capturing keyboard)
             if (event.type == SDL_KEYDOWN && !io.WantCaptureKeyboard) {
                 SDL_Keycode k = event.key.keysym.sym;
+                // offset steps in 64 bits; forward ones stop a step before the end of the file
+                const int64_t row = max(1, S.width_px), size = static_cast<int64_t>(S.data.size());
+                auto step_back = [&](const int64_t step) { S.stofs = max<int64_t>(0, S.stofs - step); };
+                auto step_forward = [&](const int64_t step) {
+                    S.stofs = max(S.stofs, min(S.stofs + step, max<int64_t>(0, size - step)));
+                };
                 // Shift+Arrows for 1-by-1 offset
                 if (event.key.keysym.mod & KMOD_SHIFT) {
-                    if (k == SDLK_UP) {
-                        S.stofs = (S.stofs > S.width_px) ? S.stofs - S.width_px : 0;
-                    } else if (k == SDLK_DOWN) {
-                        S.stofs = (static_cast<size_t>(S.stofs + S.width_px * 16) >= S.data.size() - 16)
-                        ? S.stofs
-                        : S.stofs + S.width_px;
-                    } else if (k == SDLK_LEFT) {
-                        S.stofs = (S.stofs > 0) ? S.stofs - 1 : 0;
-                    } else if (k == SDLK_RIGHT) {
-                        S.stofs = (static_cast<size_t>(S.stofs + S.width_px * 16) >= S.data.size() - 16)
-                        ? S.stofs
-                        : S.stofs + 1;
-                    }
+                    if (k == SDLK_UP) step_back(row);
+                    else if (k == SDLK_DOWN) step_forward(row);
+                    else if (k == SDLK_LEFT) step_back(1);
+                    else if (k == SDLK_RIGHT) step_forward(1);
                 }
                 // Alt+arrows for bpp/bit-align
                 else if (event.key.keysym.mod & KMOD_ALT) {
@@ -361,22 +2192,19 @@ int main(int argc, char** argv) {
                 else if (k == SDLK_RIGHT)
                     S.width_px = S.width_px + 1;
                 else if (k == SDLK_UP)
-                    S.stofs = (S.stofs > S.width_px * 16) ? S.stofs - S.width_px * 16 : 0;
+                    step_back(row * 16);
                 else if (k == SDLK_DOWN)
-                    S.stofs = (static_cast<size_t>(S.stofs + S.width_px * 16) >= S.data.size() - 16)
-                        ? S.stofs
-                        : S.stofs + S.width_px * 16;
+                    step_forward(row * 16);
                 else if (k == SDLK_PAGEUP) {
                     // compute visible rows
                     int win_w, win_h;
                     SDL_GetWindowSize(window, &win_w, &win_h);
                     int image_h = max(1, win_h);
                     int visible_rows = image_h;
-                    int visible_pixels = S.width_px * visible_rows;
-                    int visible_bits = visible_pixels * S.bpp;
-                    int page_bits = (visible_bits * 2) / 3;
-                    auto start_bit = S.stofs * 8 + S.bit_align;
-                    auto nstart = start_bit - page_bits;
+                    int64_t visible_bits = visible_rows * static_cast<int64_t>(row_stride_bits(S));
+                    int64_t page_bits = (visible_bits * 2) / 3;
+                    int64_t start_bit = S.stofs * 8 + S.bit_align;
+                    int64_t nstart = start_bit - page_bits;
                     if (nstart < 0) nstart = 0;
                     S.stofs = nstart / 8;
                     S.bit_align = nstart % 8;
@@ -385,10 +2213,9 @@ int main(int argc, char** argv) {
                     int win_w, win_h;
                     SDL_GetWindowSize(window, &win_w, &win_h);
                     int visible_rows = max(1, win_h);
-                    int visible_pixels = S.width_px * visible_rows;
-                    int visible_bits = visible_pixels * S.bpp;
-                    int page_bits = (visible_bits * 2) / 3;
-                    auto start_bit = S.stofs * 8 + S.bit_align;
+                    int64_t visible_bits = visible_rows * static_cast<int64_t>(row_stride_bits(S));
+                    int64_t page_bits = (visible_bits * 2) / 3;
+                    int64_t start_bit = S.stofs * 8 + S.bit_align;
                     int64_t nstart = start_bit + page_bits;
                     if (int64_t total_bits = static_cast<int64_t>(S.data.size()) * 8;
                         nstart > total_bits - S.bpp
@@ -444,7 +2271,20 @@ int main(int argc, char** argv) {
         ImGui::PushItemWidth(130.0f * ui_scale);
         ImGui::InputInt("Width (px/row)", &S.width_px);
         if (S.width_px < 1) S.width_px = 1;
-        ImGui::InputInt("Start offset", &S.stofs);
+        ImGui::InputInt("Row stride (bits)", &S.row_stride_bits);
+        if (S.row_stride_bits < 0) S.row_stride_bits = 0;
+        // 0 = packed rows; padding snaps the current packed row size up to a byte boundary
+        if (ImGui::Button("Packed")) S.row_stride_bits = 0;
+        for (const int pad : {1, 4, 8, 64}) {
+            ImGui::SameLine();
+            if (ImGui::Button(format("Pad {}B", pad).c_str())) {
+                const int unit = pad * 8;
+                S.row_stride_bits = (S.width_px * S.bpp + unit - 1) / unit * unit;
+            }
+        }
+        input_offset("Start offset", S.stofs);
+        ImGui::SameLine();
+        ImGui::Checkbox("Hex", &hex_offsets);
         ImGui::InputInt("Bit alignment", &S.bit_align);
         if (S.bit_align < 0) S.bit_align = 0;
         if (S.bit_align > 7) S.bit_align = 7;
@@ -454,6 +2294,83 @@ int main(int argc, char** argv) {
         ImGui::SameLine(); if (ImGui::Button("4 BPP")) S.bpp = 4;
         ImGui::SameLine(); if (ImGui::Button("8 BPP")) S.bpp = 8;
         ImGui::SameLine(); if (ImGui::Button("16 BPP")) S.bpp = 16;
+        // planar: bits per pixel is the plane count
+        ImGui::Combo("Planes", &S.planar, plane_layout_labels, IM_ARRAYSIZE(plane_layout_labels));
+        if (S.planar == planes_whole) {
+            input_offset("Plane stride (bytes)", S.plane_stride);
+        }
+        if (S.planar != planes_off) S.bpp = clamp(S.bpp, 1, max_planes);
+        // tiles: NES/GB tiles are always 2bpp, SNES/PCE ones 2/4/8bpp
+        if (ImGui::Combo("Tiles", &S.tile_format, tile_format_labels, IM_ARRAYSIZE(tile_format_labels))) {
+            if (S.tile_format == tiles_nes || S.tile_format == tiles_gb) S.bpp = 2;
+            else if (S.tile_format == tiles_snes && S.bpp != 2 && S.bpp != 8) S.bpp = 4;
+        }
+        ImGui::Combo("Swizzle", &S.swizzle, swizzle_labels, IM_ARRAYSIZE(swizzle_labels));
+        ImGui::Combo("Compression", &S.block_format, block_format_labels, IM_ARRAYSIZE(block_format_labels));
+        // YUV: planar chroma defaults to directly after a yuv_frame_h-row luma plane
+        auto chroma_after_luma = [&] {
+            S.chroma_ofs = static_cast<int64_t>(S.width_px) * yuv_frame_h;
+            S.chroma2_ofs = S.chroma_ofs + static_cast<int64_t>((S.width_px + 1) / 2) * ((yuv_frame_h + 1) / 2);
+        };
+        if (ImGui::Combo("YUV", &S.yuv_format, yuv_format_labels, IM_ARRAYSIZE(yuv_format_labels)) && S.chroma_ofs == 0)
+            chroma_after_luma();
+        if (S.yuv_format != yuv_off) {
+            ImGui::Checkbox("BT.709", &S.yuv_bt709);
+            ImGui::SameLine(); ImGui::Checkbox("Full range", &S.yuv_full_range);
+        }
+        if (S.yuv_format == yuv_nv12 || S.yuv_format == yuv_i420) {
+            ImGui::InputInt("Frame height", &yuv_frame_h);
+            yuv_frame_h = max(1, yuv_frame_h);
+            ImGui::SameLine();
+            if (ImGui::Button("Planes after luma")) chroma_after_luma();
+            input_offset(S.yuv_format == yuv_nv12 ? "UV plane offset" : "U plane offset", S.chroma_ofs);
+            if (S.yuv_format == yuv_i420) input_offset("V plane offset", S.chroma2_ofs);
+        }
+        ImGui::Combo("Sensor RAW", &S.raw_format, raw_format_labels, IM_ARRAYSIZE(raw_format_labels));
+        if (S.raw_format != raw_off) {
+            ImGui::Combo("Bayer", &S.bayer, bayer_labels, IM_ARRAYSIZE(bayer_labels));
+            ImGui::InputInt("Black level", &S.black_level);
+            ImGui::InputInt("White level", &S.white_level);
+            S.black_level = max(0, S.black_level);
+            S.white_level = max(0, S.white_level);
+        }
+        const bool was_signed = S.deep_gray == deep_signed;
+        ImGui::Combo("Deep gray", &S.deep_gray, deep_gray_labels, IM_ARRAYSIZE(deep_gray_labels));
+        // the manual window stays on the middle of the sample range when signedness changes
+        if ((S.deep_gray == deep_signed) != was_signed) S.window_level = was_signed ? 32768 : 0;
+        if (S.deep_gray != deep_off) {
+            ImGui::InputInt("Sample bits", &S.deep_bits);
+            S.deep_bits = clamp(S.deep_bits, 9, 16);
+            ImGui::Combo("Window", &S.window_mode, window_mode_labels, IM_ARRAYSIZE(window_mode_labels));
+            if (S.window_mode == window_manual) {
+                ImGui::InputInt("Level", &S.window_level);
+                ImGui::InputInt("Width", &S.window_width);
+                S.window_width = clamp(S.window_width, 1, 65536);
+            }
+        }
+        ImGui::Combo("Float", &S.float_format, float_format_labels, IM_ARRAYSIZE(float_format_labels));
+        if (S.float_format != float_off) {
+            ImGui::Checkbox("Auto range", &S.float_auto_range);
+            if (!S.float_auto_range) ImGui::SliderFloat("Exposure (stops)", &S.float_exposure, -16.0f, 16.0f, "%.1f");
+        }
+        // indexed: palette read from the file itself
+        ImGui::Checkbox("Indexed (palette)", &S.indexed);
+        if (S.indexed) {
+            input_offset("Palette offset", S.palette_ofs);
+            ImGui::Combo("Palette format", &S.palette_format, palette_format_labels, IM_ARRAYSIZE(palette_format_labels));
+            ImGui::InputInt("Palette entries", &S.palette_entries);
+            S.palette_entries = clamp(S.palette_entries, 1, 1 << palette_max_bpp);
+            if (S.bpp > palette_max_bpp) ImGui::TextDisabled("(indexed needs %d bpp or less)", palette_max_bpp);
+        }
+        if (S.tile_format != tiles_off) {
+            if (S.tile_format == tiles_linear) ImGui::InputInt("Tile width", &S.tile_w);
+            ImGui::InputInt("Tile height", &S.tile_h);
+            S.tile_w = clamp(S.tile_w, 1, 256);
+            S.tile_h = clamp(S.tile_h, 1, 256);
+            if (S.tile_format != tiles_linear) S.bpp = clamp(S.bpp, 1, max_planes);
+            int per_row = max(1, S.width_px / tile_width(S));
+            if (ImGui::InputInt("Tiles per row", &per_row)) S.width_px = max(1, per_row) * tile_width(S);
+        }
         ImGui::PopItemWidth();
 
         ImGui::Separator();
@@ -468,11 +2385,40 @@ int main(int argc, char** argv) {
                 for (const auto &f : presets[i].fields) total_bits += f.bits;
                 if (total_bits > 0) S.bpp = total_bits;
             }
+        if (ImGui::Button("Reload preset file")) reload_presets();
+        for (const auto& e : preset_errors) ImGui::TextColored(ImVec4(1, 0.4f, 0.4f, 1), "%s", e.c_str());
+
+        ImGui::Separator();
+        // transforms, applied to the bytes in this order before decoding
+        if (ImGui::TreeNode("Transforms")) {
+            int remove = -1, raise = -1;
+            for (int i = 0; i < static_cast<int>(S.transforms.size()); ++i) {
+                auto& t = S.transforms[i];
+                ImGui::PushID(i);
+                ImGui::Combo("##kind", &t.kind, transform_labels, IM_ARRAYSIZE(transform_labels));
+                if (i > 0) {
+                    ImGui::SameLine();
+                    if (ImGui::SmallButton("Up")) raise = i;
+                }
+                ImGui::SameLine();
+                if (ImGui::SmallButton("Remove")) remove = i;
+                if (t.kind == transform_xor) ImGui::InputText("Key (hex)", t.key_hex.data(), t.key_hex.size());
+                if (t.kind == transform_delta) {
+                    ImGui::InputInt("Distance", &t.distance);
+                    t.distance = clamp(t.distance, 1, 16);
+                }
+                ImGui::PopID();
+            }
+            if (raise > 0) swap(S.transforms[raise - 1], S.transforms[raise]);
+            if (remove >= 0) S.transforms.erase(S.transforms.begin() + remove);
+            if (ImGui::Button("Add transform")) S.transforms.emplace_back();
+            ImGui::TreePop();
+        }
 
         ImGui::Separator();
         ImGui::Text("Orders:");
         ImGui::Checkbox("Bit-order MSB", &S.bit_order_msb);
-        ImGui::Checkbox("Byte-order LE", &S.byte_order_le);
+        ImGui::Combo("Byte order", &S.byte_order, byte_order_labels, IM_ARRAYSIZE(byte_order_labels));
 
         if (ImGui::Button("Center start (0)")) {
             S.stofs = 0;
@@ -489,6 +2435,26 @@ int main(int argc, char** argv) {
         ImGui::Text("Alt+Up/Dn Change BPP");
         ImGui::Text("Alt+Lt/Rt Change bit-align");
 
+        ImGui::Separator();
+        ImGui::Text("Decode kernels: %s", decode_isa->name);
+        // file block cache: memory budget and how well it is doing
+        ImGui::PushItemWidth(130.0f * ui_scale);
+        if (ImGui::InputInt("Cache budget (MiB)", &cache_budget_mb)) {
+            cache_budget_mb = max(1, cache_budget_mb);
+            BlockCache::budget = static_cast<size_t>(cache_budget_mb) << 20;
+        }
+        ImGui::PopItemWidth();
+        if (const BlockCache* cache = S.data.cache()) {
+            const auto st = cache->stats();
+            const uint64_t lookups = st.hits + st.misses;
+            ImGui::Text("Cached: %zu MiB, %llu hits / %llu misses (%.0f%%)", st.resident >> 20,
+                        static_cast<unsigned long long>(st.hits), static_cast<unsigned long long>(st.misses),
+                        lookups ? 100.0 * st.hits / lookups : 0.0);
+            ImGui::Text("Read ahead: %llu blocks, %llu used (%.0f%%)", static_cast<unsigned long long>(st.prefetched),
+                        static_cast<unsigned long long>(st.prefetch_hits),
+                        st.prefetched ? 100.0 * st.prefetch_hits / st.prefetched : 0.0);
+        }
+
         ImGui::End();
 
         // Right-side: image area - occupy remaining space; place texture inside a child to control layout
@@ -501,18 +2467,27 @@ int main(int argc, char** argv) {
         if (display_w < 1) display_w = 64;
         if (display_h < 1) display_h = 64;
 
-        // perform deferred load if requested
+        // perform deferred load if requested; this only opens the file, the block cache's loader
+        // thread reads it (what is on screen first) while the UI keeps going
         if (load_requested) {
             if (!load_file_into(S, path.c_str())) {
                 cerr << "Failed to open file: " << path << endl;
             }
             load_requested = false;
         }
+        if (const BlockCache* cache = S.data.cache()) {
+            if (const auto st = cache->stats(); st.pending || st.resident < st.target) {
+                ImGui::ProgressBar(static_cast<float>(st.resident) / st.target, ImVec2(-1, 0),
+                                   format("Loading {} / {} MiB", st.resident >> 20, st.target >> 20).c_str());
+                display_h = max(1, display_h - static_cast<int>(ImGui::GetFrameHeightWithSpacing()));
+            }
+        }
 
         // Render viewport into RGBA buffer of size width x visible_rows (visible rows = display_h)
         int rows = display_h;
         vector<uint8_t> pixels;
         uint32_t rows_rendered = 0;
+        readahead.update(S, rows);
         render_viewport(S, presets[S.preset_idx], rows, pixels, rows_rendered);
 
         // upload to GL texture
@@ -585,3 +2560,4 @@ int main(int argc, char** argv) {
 
     return 0;
 }
+#endif
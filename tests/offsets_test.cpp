@@ -0,0 +1,105 @@
+// Offset test: decodes views of a sparse file just below and above 2^31 and 2^32, where 32-bit
+// offset arithmetic would wrap, with every kernel tier this CPU supports.
+// Usage: offsets_test [scratch file]
+
+#include "main.cpp"
+
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+
+static constexpr int64_t bases[] = {int64_t{1} << 31, int64_t{1} << 32};
+static constexpr int64_t reach = 4096; // pattern bytes written either side of each base
+static constexpr int64_t file_size = (int64_t{1} << 32) + (int64_t{1} << 20);
+static constexpr int64_t steps[] = {-reach / 2, -1000, -513, -512, -17, -1, 0, 1, 15, 255, 1000, reach / 2};
+static constexpr int width = 64, rows = 8;
+
+static uint8_t pattern(const int64_t ofs) { return static_cast<uint8_t>((ofs * 131) ^ (ofs >> 7) ^ 0x5a); }
+
+// A file of file_size bytes that only holds the pattern around the bases
+static bool make_sparse_file(const string& path) {
+    FILE* f = fopen(path.c_str(), "wb");
+    if (!f) return false;
+#ifdef _WIN32
+    const bool sized = _chsize_s(_fileno(f), file_size) == 0;
+#else
+    const bool sized = ftruncate(fileno(f), static_cast<off_t>(file_size)) == 0;
+#endif
+    if (fclose(f) != 0 || !sized) return false;
+    fstream out(path, ios::binary | ios::in | ios::out);
+    for (const int64_t base : bases) {
+        vector<char> bytes(2 * reach);
+        for (int64_t i = 0; i < 2 * reach; ++i) bytes[i] = static_cast<char>(pattern(base - reach + i));
+        out.seekp(base - reach);
+        out.write(bytes.data(), static_cast<streamsize>(bytes.size()));
+    }
+    return static_cast<bool>(out.flush());
+}
+
+// The view at S.stofs once its bytes are loaded
+static const ViewerState* loaded_view(const ViewerState& S) {
+    vector<BlockCache::Range> missing;
+    for (int tries = 0; tries < 10000; ++tries) {
+        missing.clear();
+        const ViewerState& s = window_view(S, rows, missing);
+        if (missing.empty()) return &s;
+        this_thread::sleep_for(chrono::milliseconds(1));
+    }
+    return nullptr;
+}
+
+int main(int argc, char** argv) {
+    const string path = argc > 1 ? argv[1] : "offsets_test.bin";
+    if (!make_sparse_file(path)) {
+        fprintf(stderr, "Error: can't create %s\n", path.c_str());
+        remove(path.c_str());
+        return 1;
+    }
+    int failures = 0;
+    {
+        ViewerState S;
+        const bool loaded = load_file_into(S, path) && static_cast<int64_t>(S.data.size()) == file_size;
+        if (!loaded) {
+            fprintf(stderr, "Error: can't load %s\n", path.c_str());
+            failures = 1;
+        }
+        const vector<Preset> presets = build_presets();
+        const Preset& gray8 = presets[4];
+        S.bpp = 8;
+        S.width_px = width;
+        for (const auto& isa : decode_isas) {
+            if (!loaded || !isa.supported()) continue;
+            decode_isa = &isa;
+            for (const int64_t base : bases) {
+                for (const int64_t step : steps) {
+                    S.stofs = base + step;
+                    const ViewerState* s = loaded_view(S);
+                    if (!s) {
+                        fprintf(stderr, "FAIL %s: offset %lld never loaded\n", isa.name, static_cast<long long>(S.stofs));
+                        ++failures;
+                        continue;
+                    }
+                    vector<uint8_t> pixels;
+                    uint32_t rendered = 0;
+                    decode_viewport(*s, gray8, rows, pixels, rendered);
+                    int64_t bad = -1;
+                    for (int64_t i = 0; i < int64_t{width} * rows && bad < 0; ++i) {
+                        const uint8_t v = pattern(S.stofs + i);
+                        const uint8_t* p = &pixels[i * 4];
+                        if (rendered != rows || p[0] != v || p[1] != v || p[2] != v || p[3] != 255) bad = i;
+                    }
+                    if (bad >= 0) {
+                        fprintf(stderr, "FAIL %s: offset %lld, pixel %lld\n", isa.name,
+                                static_cast<long long>(S.stofs), static_cast<long long>(bad));
+                        ++failures;
+                    }
+                }
+            }
+        }
+    }
+    remove(path.c_str());
+    printf("%d failures\n", failures);
+    return failures ? 1 : 0;
+}